@@ -0,0 +1,490 @@
+//
+//  GpuVideoBench.cpp
+//
+//  Measures open time, per-frame read + LZ4 decode latency and sustained
+//  frames/sec of every load Mode against a synthetic .gv file.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "Util.h"
+#include "GpuVideo.h"
+#include "GpuVideoIO.h"
+#include "GpuVideoReader.h"
+#include "GpuVideoReaderDecompressed.h"
+#include "GpuVideoReaderMapped.h"
+#include "GpuVideoReaderCached.h"
+#include "GpuVideoPrefetcher.h"
+#include "SyntheticGpuVideo.h"
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    double elapsedMs(Clock::time_point from, Clock::time_point to) {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+
+    struct BenchOptions {
+        uint32_t width = 1920;
+        uint32_t height = 1080;
+        uint32_t frames = 240;
+        float fps = 30.0f;
+        GPU_COMPRESS format = GPU_COMPRESS_DXT5;
+        int passes = 3;
+        int threads = 0;
+        uint32_t stripRows = 0;
+        int prefetch = 4;
+        float speed = 1.0f;
+        double cookMs = 4.0;
+        double cacheMb = 256.0;
+        int queue = 8;
+        int clips = 4;
+        int coalesce = 8;
+        std::string path = "gpuvideo_bench.gv";
+        bool keep = false;
+    };
+
+    struct BenchResult {
+        double openMs = 0.0;
+        double p50Ms = 0.0;
+        double p99Ms = 0.0;
+        double framesPerSecond = 0.0;
+    };
+
+    // One row per reader configuration; the Mode rows match what ExGpuVideoTOP::load builds.
+    struct BenchCase {
+        const char* name;
+        Mode mode;
+        std::shared_ptr<IGpuVideoReader>(*open)(const char* path);
+    };
+
+    const BenchCase kCases[] = {
+        { "StreamingFromStorage", GPU_VIDEO_STREAMING_FROM_STORAGE,
+            [](const char* path) -> std::shared_ptr<IGpuVideoReader> { return std::make_shared<GpuVideoReader>(path, false); } },
+        { "StreamingFromCpuMemory", GPU_VIDEO_STREAMING_FROM_CPU_MEMORY,
+            [](const char* path) -> std::shared_ptr<IGpuVideoReader> { return std::make_shared<GpuVideoReaderMapped>(path); } },
+        { "StreamingFromCpuMemory (copy)", GPU_VIDEO_STREAMING_FROM_CPU_MEMORY,
+            [](const char* path) -> std::shared_ptr<IGpuVideoReader> { return std::make_shared<GpuVideoReader>(path, true); } },
+        { "StreamingFromCpuMemoryDecompressed", GPU_VIDEO_STREAMING_FROM_CPU_MEMORY_DECOMPRESSED,
+            [](const char* path) -> std::shared_ptr<IGpuVideoReader> { return std::make_shared<GpuVideoReaderDecompressed>(std::make_shared<GpuVideoReader>(path, false)); } },
+        { "OnGpuMemory", GPU_VIDEO_ON_GPU_MEMORY,
+            [](const char* path) -> std::shared_ptr<IGpuVideoReader> { return std::make_shared<GpuVideoReader>(path, false); } },
+    };
+
+    double percentile(std::vector<double> samples, double p) {
+        if (samples.empty()) {
+            return 0.0;
+        }
+        std::size_t n = static_cast<std::size_t>(p * (samples.size() - 1) + 0.5);
+        std::nth_element(samples.begin(), samples.begin() + n, samples.end());
+        return samples[n];
+    }
+
+    // threads > 1 splits every pass across workers sharing one reader (interleaved frames).
+    BenchResult benchCase(const BenchCase& c, const BenchOptions& options, int threads) {
+        BenchResult result;
+        Mode mode = c.mode;
+
+        Clock::time_point openBegin = Clock::now();
+        std::shared_ptr<IGpuVideoReader> reader = c.open(options.path.c_str());
+        Clock::time_point openEnd = Clock::now();
+        result.openMs = elapsedMs(openBegin, openEnd);
+
+        // On GPU Memory reads every frame once at load; streaming modes read per cook.
+        int passes = mode == GPU_VIDEO_ON_GPU_MEMORY ? 1 : options.passes;
+
+        std::vector<std::vector<double>> perThread(threads);
+        auto work = [&](int t) {
+            std::vector<uint8_t> dst(reader->getFrameBytes());
+            std::vector<double>& samples = perThread[t];
+            samples.reserve(reader->getFrameCount() * passes / threads + 1);
+            for (int pass = 0; pass < passes; ++pass) {
+                for (uint32_t i = t; i < reader->getFrameCount(); i += threads) {
+                    Clock::time_point begin = Clock::now();
+                    reader->read(dst.data(), i);
+                    samples.push_back(elapsedMs(begin, Clock::now()));
+                }
+            }
+        };
+
+        Clock::time_point sustainedBegin = Clock::now();
+        std::vector<std::thread> workers;
+        for (int t = 1; t < threads; ++t) {
+            workers.emplace_back(work, t);
+        }
+        work(0);
+        for (std::thread& w : workers) {
+            w.join();
+        }
+        double sustainedMs = elapsedMs(sustainedBegin, Clock::now());
+
+        std::vector<double> samples;
+        for (const std::vector<double>& s : perThread) {
+            samples.insert(samples.end(), s.begin(), s.end());
+        }
+
+        if (mode == GPU_VIDEO_ON_GPU_MEMORY) {
+            result.openMs += sustainedMs;
+        }
+        result.p50Ms = percentile(samples, 0.50);
+        result.p99Ms = percentile(samples, 0.99);
+        result.framesPerSecond = sustainedMs > 0.0 ? samples.size() * 1000.0 / sustainedMs : 0.0;
+        return result;
+    }
+
+    // Simulated cook loop: acquire the frame for this cook, then spend cookMs on "rendering"
+    // while the prefetcher works ahead. Reports acquire latency and hit rate.
+    BenchResult benchPrefetch(const BenchCase& c, const BenchOptions& options, double* hitRate) {
+        BenchResult result;
+        std::shared_ptr<IGpuVideoReader> reader = c.open(options.path.c_str());
+        GpuVideoPrefetcher prefetcher(reader, options.prefetch);
+
+        std::vector<double> samples;
+        float position = 0.0f;
+        int last = -1;
+        uint32_t cooks = reader->getFrameCount() * options.passes;
+
+        Clock::time_point sustainedBegin = Clock::now();
+        for (uint32_t i = 0; i < cooks; ++i) {
+            int count = static_cast<int>(reader->getFrameCount());
+            int frame = ((static_cast<int>(std::floor(position)) % count) + count) % count;
+            position += options.speed;
+            if (frame == last) {
+                continue;
+            }
+            last = frame;
+
+            Clock::time_point begin = Clock::now();
+            GpuVideoPrefetcher::Lease lease = prefetcher.acquire(frame);
+            samples.push_back(elapsedMs(begin, Clock::now()));
+            prefetcher.release(lease.slot);
+
+            std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(options.cookMs));
+        }
+        double sustainedMs = elapsedMs(sustainedBegin, Clock::now());
+
+        result.p50Ms = percentile(samples, 0.50);
+        result.p99Ms = percentile(samples, 0.99);
+        result.framesPerSecond = sustainedMs > 0.0 ? samples.size() * 1000.0 / sustainedMs : 0.0;
+        uint64_t total = prefetcher.getHits() + prefetcher.getMisses();
+        *hitRate = total ? static_cast<double>(prefetcher.getHits()) / total : 0.0;
+        return result;
+    }
+
+    // clips storage readers on the file, each reading every frame once: read() on a thread per clip,
+    // or readAsync() keeping options.queue reads per clip in flight on one shared fetch engine of
+    // depth options.queue (io_uring or pread threads). Latency is request to completion.
+    // coalesce > 1 merges the reads of that many consecutive frames.
+    BenchResult benchFetch(const BenchOptions& options, bool async, bool uring, int coalesce, std::string* backend) {
+        BenchResult result;
+        GpuVideoFetchEngine::shutdownShared();
+        GpuVideoFetchEngine::configureShared(options.queue, uring);
+        std::vector<std::shared_ptr<GpuVideoReader>> readers;
+        for (int i = 0; i < options.clips; ++i) {
+            readers.push_back(std::make_shared<GpuVideoReader>(options.path.c_str(), false));
+            readers.back()->setCoalesceFrames(coalesce);
+        }
+        uint32_t count = readers[0]->getFrameCount();
+        uint32_t frameBytes = readers[0]->getFrameBytes();
+
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::vector<double> samples;
+        auto clip = [&](int c) {
+            const GpuVideoReader& reader = *readers[c];
+            GpuVideoReadCursor cursor;
+            std::vector<uint8_t> frames(static_cast<size_t>(async ? options.queue : 1) * frameBytes);
+            std::vector<double> own;
+            if (!async) {
+                for (uint32_t i = 0; i < count; ++i) {
+                    Clock::time_point begin = Clock::now();
+                    reader.read(frames.data(), i, &cursor);
+                    own.push_back(elapsedMs(begin, Clock::now()));
+                }
+            }
+            else {
+                int inFlight = 0;
+                std::vector<int> freeSlots;
+                for (int i = 0; i < options.queue; ++i) {
+                    freeSlots.push_back(i);
+                }
+                for (uint32_t i = 0; i < count; ++i) {
+                    int slot = 0;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        cond.wait(lock, [&]() { return !freeSlots.empty(); });
+                        slot = freeSlots.back();
+                        freeSlots.pop_back();
+                        ++inFlight;
+                    }
+                    Clock::time_point begin = Clock::now();
+                    reader.readAsync(frames.data() + static_cast<size_t>(slot) * frameBytes, i, begin, [&, slot, begin]() {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        own.push_back(elapsedMs(begin, Clock::now()));
+                        freeSlots.push_back(slot);
+                        --inFlight;
+                        cond.notify_all();
+                    }, &cursor);
+                }
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [&]() { return inFlight == 0; });
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            samples.insert(samples.end(), own.begin(), own.end());
+        };
+
+        Clock::time_point sustainedBegin = Clock::now();
+        std::vector<std::thread> workers;
+        for (int c = 0; c < options.clips; ++c) {
+            workers.emplace_back(clip, c);
+        }
+        for (std::thread& w : workers) {
+            w.join();
+        }
+        double sustainedMs = elapsedMs(sustainedBegin, Clock::now());
+
+        *backend = async ? readers[0]->getFetchBackend() : "pread";
+        result.p50Ms = percentile(samples, 0.50);
+        result.p99Ms = percentile(samples, 0.99);
+        result.framesPerSecond = sustainedMs > 0.0 ? samples.size() * 1000.0 / sustainedMs : 0.0;
+        return result;
+    }
+
+    // Ping-pong loop (0 .. n-1 .. 0) over the first loopFrames frames (0 = all) through a frame
+    // cache of cacheMb; 0 MB measures the bare reader.
+    BenchResult benchCache(const BenchCase& c, const BenchOptions& options, double cacheMb, int loopFrames, double* hitRate) {
+        BenchResult result;
+        std::shared_ptr<GpuVideoReaderCached> reader = std::make_shared<GpuVideoReaderCached>(
+            c.open(options.path.c_str()), static_cast<uint64_t>(cacheMb * 1024.0 * 1024.0));
+
+        std::vector<uint8_t> dst(reader->getFrameBytes());
+        std::vector<double> samples;
+        int count = static_cast<int>(reader->getFrameCount());
+        if (0 < loopFrames) {
+            count = std::min(count, loopFrames);
+        }
+        int period = std::max(1, 2 * count - 2);
+
+        Clock::time_point sustainedBegin = Clock::now();
+        for (int i = 0; i < period * options.passes; ++i) {
+            int phase = i % period;
+            int frame = phase < count ? phase : period - phase;
+            Clock::time_point begin = Clock::now();
+            reader->read(dst.data(), frame);
+            samples.push_back(elapsedMs(begin, Clock::now()));
+        }
+        double sustainedMs = elapsedMs(sustainedBegin, Clock::now());
+
+        result.p50Ms = percentile(samples, 0.50);
+        result.p99Ms = percentile(samples, 0.99);
+        result.framesPerSecond = sustainedMs > 0.0 ? samples.size() * 1000.0 / sustainedMs : 0.0;
+        uint64_t total = reader->getHits() + reader->getMisses();
+        *hitRate = total ? static_cast<double>(reader->getHits()) / total : 0.0;
+        return result;
+    }
+
+    void usage(const char* exe) {
+        std::printf("usage: %s [--width N] [--height N] [--frames N] [--fps F] [--format 1|3|5|7] [--passes N] [--threads N] [--strip-rows N] [--prefetch N] [--speed F] [--cookms F] [--cachemb F] [--queue N] [--clips N] [--coalesce N] [--file PATH] [--keep]\n", exe);
+    }
+
+    bool parseOptions(int argc, char** argv, BenchOptions& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--keep") {
+                options.keep = true;
+            }
+            else if (arg == "--width" && hasValue) {
+                options.width = static_cast<uint32_t>(std::atoi(argv[++i]));
+            }
+            else if (arg == "--height" && hasValue) {
+                options.height = static_cast<uint32_t>(std::atoi(argv[++i]));
+            }
+            else if (arg == "--frames" && hasValue) {
+                options.frames = static_cast<uint32_t>(std::atoi(argv[++i]));
+            }
+            else if (arg == "--fps" && hasValue) {
+                options.fps = static_cast<float>(std::atof(argv[++i]));
+            }
+            else if (arg == "--format" && hasValue) {
+                options.format = static_cast<GPU_COMPRESS>(std::atoi(argv[++i]));
+            }
+            else if (arg == "--passes" && hasValue) {
+                options.passes = std::atoi(argv[++i]);
+            }
+            else if (arg == "--threads" && hasValue) {
+                options.threads = std::atoi(argv[++i]);
+            }
+            else if (arg == "--strip-rows" && hasValue) {
+                options.stripRows = static_cast<uint32_t>(std::atoi(argv[++i]));
+            }
+            else if (arg == "--prefetch" && hasValue) {
+                options.prefetch = std::atoi(argv[++i]);
+            }
+            else if (arg == "--speed" && hasValue) {
+                options.speed = static_cast<float>(std::atof(argv[++i]));
+            }
+            else if (arg == "--cookms" && hasValue) {
+                options.cookMs = std::atof(argv[++i]);
+            }
+            else if (arg == "--cachemb" && hasValue) {
+                options.cacheMb = std::atof(argv[++i]);
+            }
+            else if (arg == "--queue" && hasValue) {
+                options.queue = std::atoi(argv[++i]);
+            }
+            else if (arg == "--coalesce" && hasValue) {
+                options.coalesce = std::atoi(argv[++i]);
+            }
+            else if (arg == "--clips" && hasValue) {
+                options.clips = std::atoi(argv[++i]);
+            }
+            else if (arg == "--file" && hasValue) {
+                options.path = argv[++i];
+            }
+            else {
+                return false;
+            }
+        }
+        if (options.threads <= 0) {
+            options.threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        }
+        return options.width > 0 && options.height > 0 && options.frames > 0 && options.passes > 0 && options.speed != 0.0f;
+    }
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    try {
+        SyntheticClip clip;
+        clip.width = options.width;
+        clip.height = options.height;
+        clip.frames = options.frames;
+        clip.fps = options.fps;
+        clip.format = options.format;
+        clip.stripRows = options.stripRows;
+        writeSyntheticGpuVideo(options.path.c_str(), clip);
+
+        std::printf("%ux%u, %u frames, format %u, strip rows %u, %d passes, %s\n",
+            options.width, options.height, options.frames, (uint32_t)options.format, options.stripRows, options.passes, options.path.c_str());
+        std::printf("%-36s %10s %10s %10s %12s\n", "mode", "open ms", "p50 ms", "p99 ms", "frames/sec");
+
+        for (const BenchCase& c : kCases) {
+            BenchResult r = benchCase(c, options, 1);
+            std::printf("%-36s %10.2f %10.3f %10.3f %12.1f\n", c.name, r.openMs, r.p50Ms, r.p99Ms, r.framesPerSecond);
+        }
+
+        if (options.threads > 1) {
+            std::printf("\nconcurrent readers on one instance, %d threads\n", options.threads);
+            for (const BenchCase& c : kCases) {
+                if (c.mode == GPU_VIDEO_ON_GPU_MEMORY) {
+                    continue;
+                }
+                BenchResult r = benchCase(c, options, options.threads);
+                std::printf("%-36s %10.2f %10.3f %10.3f %12.1f\n", c.name, r.openMs, r.p50Ms, r.p99Ms, r.framesPerSecond);
+            }
+        }
+
+        if (options.prefetch > 0) {
+            std::printf("\nprefetch depth %d, speed %g, %g ms per cook\n", options.prefetch, options.speed, options.cookMs);
+            std::printf("%-36s %10s %10s %10s %12s\n", "mode", "hit rate", "p50 ms", "p99 ms", "frames/sec");
+            for (const BenchCase& c : kCases) {
+                if (c.mode == GPU_VIDEO_ON_GPU_MEMORY) {
+                    continue;
+                }
+                double hitRate = 0.0;
+                BenchResult r = benchPrefetch(c, options, &hitRate);
+                std::printf("%-36s %10.2f %10.3f %10.3f %12.1f\n", c.name, hitRate, r.p50Ms, r.p99Ms, r.framesPerSecond);
+            }
+        }
+
+        if (options.queue > 0 && options.clips > 0) {
+            std::printf("\n%d clips streaming from storage at once, async queue depth %d\n", options.clips, options.queue);
+            std::printf("%-36s %10s %10s %10s %12s\n", "mode", "", "p50 ms", "p99 ms", "frames/sec");
+            // read(), readAsync() on pread threads, readAsync() on io_uring
+            for (int path = 0; path < 3; ++path) {
+                bool async = path != 0;
+                bool uring = path == 2;
+                for (int coalesce : { 0, options.coalesce }) {
+                    if (coalesce != 0 && options.coalesce <= 1) {
+                        continue;
+                    }
+                    std::string backend;
+                    BenchResult r = benchFetch(options, async, uring, coalesce, &backend);
+                    if (uring && backend != "io_uring") {
+                        // Not available here; the threads row already covers it.
+                        break;
+                    }
+                    std::string name = std::string(async ? "readAsync (" : "read (") + backend + ")";
+                    if (1 < coalesce) {
+                        name += " x" + std::to_string(coalesce);
+                    }
+                    std::printf("%-36s %10s %10.3f %10.3f %12.1f\n", name.c_str(), "", r.p50Ms, r.p99Ms, r.framesPerSecond);
+                }
+            }
+        }
+
+        if (options.cacheMb > 0.0) {
+            // A loop that fits the cache is what it is for; one over the whole clip shows the cost when it does not.
+            uint64_t frameBytes = GpuVideoReader(options.path.c_str(), false).getFrameBytes();
+            int fitting = static_cast<int>(options.cacheMb * 1024.0 * 1024.0 / frameBytes);
+            struct Loop {
+                const char* name;
+                int frames;
+            };
+            const Loop loops[] = {
+                { "frames that fit", fitting },
+                { "whole clip", 0 },
+            };
+            for (const Loop& loop : loops) {
+                if (loop.frames == 0 && static_cast<int>(options.frames) <= fitting) {
+                    continue;
+                }
+                std::printf("\nping-pong loop over %s (%u frames), frame cache %g MB vs none\n", loop.name,
+                    loop.frames != 0 ? std::min(static_cast<uint32_t>(loop.frames), options.frames) : options.frames, options.cacheMb);
+                std::printf("%-36s %10s %10s %10s %12s\n", "mode", "hit rate", "p50 ms", "p99 ms", "frames/sec");
+                for (const BenchCase& c : kCases) {
+                    if (c.mode != GPU_VIDEO_STREAMING_FROM_STORAGE && c.mode != GPU_VIDEO_STREAMING_FROM_CPU_MEMORY) {
+                        continue;
+                    }
+                    for (double mb : { 0.0, options.cacheMb }) {
+                        double hitRate = 0.0;
+                        BenchResult r = benchCache(c, options, mb, loop.frames, &hitRate);
+                        std::string name = std::string(c.name) + (mb > 0.0 ? " +cache" : "");
+                        std::printf("%-36s %10.2f %10.3f %10.3f %12.1f\n", name.c_str(), hitRate, r.p50Ms, r.p99Ms, r.framesPerSecond);
+                    }
+                }
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "error: %s\n", e.what());
+        if (!options.keep) {
+            std::remove(options.path.c_str());
+        }
+        return 1;
+    }
+
+    if (!options.keep) {
+        std::remove(options.path.c_str());
+    }
+    return 0;
+}
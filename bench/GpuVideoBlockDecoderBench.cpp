@@ -0,0 +1,123 @@
+//
+//  GpuVideoBlockDecoderBench.cpp
+//
+//  Throughput of GpuVideoBlockDecoder per format and instruction set,
+//  checked bit for bit against the scalar reference.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+#include "GpuVideo.h"
+#include "GpuVideoBlockDecoder.h"
+#include "SyntheticGpuVideo.h"
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    struct BenchOptions {
+        uint32_t width = 1920;
+        uint32_t height = 1080;
+        int passes = 3;
+        uint32_t threads = 0;
+    };
+
+    // Random blocks: every DXT1 colour mode, DXT5 alpha mode and BC7 mode shows up.
+    std::vector<uint8_t> randomBlocks(uint32_t width, uint32_t height, GPU_COMPRESS format) {
+        size_t blocks = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4);
+        std::vector<uint8_t> data(blocks * syntheticBlockBytes(format));
+        for (size_t i = 0; i < data.size(); i += 4) {
+            uint32_t v = syntheticHash(static_cast<uint32_t>(i) * 2654435761u + format);
+            memcpy(&data[i], &v, 4);
+        }
+        return data;
+    }
+
+    void usage(const char* exe) {
+        std::printf("usage: %s [--width N] [--height N] [--passes N] [--threads N]\n", exe);
+    }
+
+    bool parseOptions(int argc, char** argv, BenchOptions& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--width" && hasValue) {
+                options.width = static_cast<uint32_t>(std::atoi(argv[++i]));
+            }
+            else if (arg == "--height" && hasValue) {
+                options.height = static_cast<uint32_t>(std::atoi(argv[++i]));
+            }
+            else if (arg == "--passes" && hasValue) {
+                options.passes = std::max(1, std::atoi(argv[++i]));
+            }
+            else if (arg == "--threads" && hasValue) {
+                options.threads = static_cast<uint32_t>(std::atoi(argv[++i]));
+            }
+            else {
+                return false;
+            }
+        }
+        return options.width > 0 && options.height > 0;
+    }
+
+    // Best of passes, in megapixels per second.
+    double decodeRate(const GpuVideoBlockDecoder& decoder, const std::vector<uint8_t>& blocks, uint32_t width, uint32_t height, std::vector<uint8_t>& rgba, uint32_t threads, int passes) {
+        double best = 0.0;
+        for (int pass = 0; pass < passes; ++pass) {
+            Clock::time_point begin = Clock::now();
+            decoder.decode(blocks.data(), width, height, rgba.data(), width * 4, threads);
+            double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+            best = std::max(best, double(width) * height / 1.0e6 / std::max(seconds, 1.0e-9));
+        }
+        return best;
+    }
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    try {
+        const GPU_COMPRESS formats[] = { GPU_COMPRESS_DXT1, GPU_COMPRESS_DXT3, GPU_COMPRESS_DXT5, GPU_COMPRESS_BC7 };
+        size_t pixels = static_cast<size_t>(options.width) * options.height;
+
+        std::printf("%ux%u, random blocks, best of %d passes, cpu supports %s\n", options.width, options.height,
+            options.passes, GpuVideoBlockEncoder::isaName(GpuVideoBlockEncoder::bestIsa()));
+        std::printf("%-8s %-8s %12s %14s %12s\n", "format", "isa", "MPix/s 1T", "MPix/s all", "mismatches");
+
+        for (GPU_COMPRESS format : formats) {
+            std::vector<uint8_t> blocks = randomBlocks(options.width, options.height, format);
+            std::vector<uint8_t> expected(pixels * 4);
+            GpuVideoBlockDecoder(format, GpuVideoBlockEncoder::ISA_SCALAR).decode(blocks.data(), options.width, options.height, expected.data(), options.width * 4, 1);
+
+            for (int isa = GpuVideoBlockEncoder::ISA_SCALAR; isa <= GpuVideoBlockEncoder::bestIsa(); ++isa) {
+                GpuVideoBlockDecoder decoder(format, static_cast<GpuVideoBlockEncoder::Isa>(isa));
+                std::vector<uint8_t> rgba(pixels * 4);
+                double single = decodeRate(decoder, blocks, options.width, options.height, rgba, 1, options.passes);
+                double parallel = decodeRate(decoder, blocks, options.width, options.height, rgba, options.threads, options.passes);
+
+                uint32_t mismatches = 0;
+                for (size_t i = 0; i < pixels; ++i) {
+                    mismatches += memcmp(&rgba[i * 4], &expected[i * 4], 4) != 0;
+                }
+                std::printf("%-8u %-8s %12.1f %14.1f %12u\n", (uint32_t)format, GpuVideoBlockEncoder::isaName(decoder.getIsa()),
+                    single, parallel, mismatches);
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "error: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
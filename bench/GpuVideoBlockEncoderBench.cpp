@@ -0,0 +1,172 @@
+//
+//  GpuVideoBlockEncoderBench.cpp
+//
+//  Throughput and PSNR of GpuVideoBlockEncoder per instruction set and
+//  quality preset, checked bit for bit against the scalar reference.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "GpuVideo.h"
+#include "GpuVideoBlockEncoder.h"
+#include "GpuVideoBlockDecoder.h"
+#include "SyntheticGpuVideo.h"
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    struct BenchOptions {
+        uint32_t width = 1920;
+        uint32_t height = 1080;
+        GPU_COMPRESS format = GPU_COMPRESS_DXT5;
+        int passes = 3;
+        uint32_t threads = 0;
+    };
+
+    // Smooth gradients, hard edges and a noisy region, with an alpha ramp.
+    std::vector<uint8_t> syntheticImage(uint32_t width, uint32_t height) {
+        std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4);
+        for (uint32_t y = 0; y < height; ++y) {
+            for (uint32_t x = 0; x < width; ++x) {
+                uint8_t* p = &rgba[(static_cast<size_t>(y) * width + x) * 4];
+                double u = double(x) / width, v = double(y) / height;
+                int r = static_cast<int>(127.5 + 127.5 * std::sin(u * 9.0 + v * 3.0));
+                int g = static_cast<int>(255.0 * v);
+                int b = static_cast<int>(127.5 + 127.5 * std::cos(u * 4.0 - v * 7.0));
+                if (((x / 64) + (y / 64)) % 5 == 0) {
+                    // checker cells with hard edges
+                    bool on = ((x / 8) + (y / 8)) % 2 == 0;
+                    r = on ? 230 : 20;
+                    g = on ? 40 : 200;
+                    b = on ? 90 : 160;
+                }
+                else if (x > width * 3 / 4) {
+                    uint32_t noise = syntheticHash(x * 73856093u ^ y * 19349663u);
+                    r = std::min(255, std::max(0, r + int(noise & 31) - 16));
+                    g = std::min(255, std::max(0, g + int((noise >> 8) & 31) - 16));
+                    b = std::min(255, std::max(0, b + int((noise >> 16) & 31) - 16));
+                }
+                p[0] = static_cast<uint8_t>(r);
+                p[1] = static_cast<uint8_t>(g);
+                p[2] = static_cast<uint8_t>(b);
+                p[3] = static_cast<uint8_t>(255.0 * (0.5 + 0.5 * std::sin(u * 6.0) * std::cos(v * 5.0)));
+            }
+        }
+        return rgba;
+    }
+
+    // PSNR over RGB (and alpha for DXT5).
+    double psnr(const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height, const std::vector<uint8_t>& blocks, GPU_COMPRESS format) {
+        std::vector<uint8_t> decoded(rgba.size());
+        GpuVideoBlockDecoder(format, GpuVideoBlockEncoder::ISA_SCALAR).decode(blocks.data(), width, height, decoded.data(), width * 4, 1);
+        int channels = format == GPU_COMPRESS_DXT1 ? 3 : 4;
+        double squared = 0.0;
+        for (size_t i = 0; i < rgba.size(); ++i) {
+            if (static_cast<int>(i % 4) < channels) {
+                double d = double(rgba[i]) - decoded[i];
+                squared += d * d;
+            }
+        }
+        double mse = squared / (double(width) * height * channels);
+        return mse <= 0.0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 / mse);
+    }
+
+    void usage(const char* exe) {
+        std::printf("usage: %s [--width N] [--height N] [--format 1|5] [--passes N] [--threads N]\n", exe);
+    }
+
+    bool parseOptions(int argc, char** argv, BenchOptions& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--width" && hasValue) {
+                options.width = static_cast<uint32_t>(std::atoi(argv[++i]));
+            }
+            else if (arg == "--height" && hasValue) {
+                options.height = static_cast<uint32_t>(std::atoi(argv[++i]));
+            }
+            else if (arg == "--format" && hasValue) {
+                options.format = static_cast<GPU_COMPRESS>(std::atoi(argv[++i]));
+            }
+            else if (arg == "--passes" && hasValue) {
+                options.passes = std::max(1, std::atoi(argv[++i]));
+            }
+            else if (arg == "--threads" && hasValue) {
+                options.threads = static_cast<uint32_t>(std::atoi(argv[++i]));
+            }
+            else {
+                return false;
+            }
+        }
+        return options.width > 0 && options.height > 0
+            && (options.format == GPU_COMPRESS_DXT1 || options.format == GPU_COMPRESS_DXT5);
+    }
+
+    // Best of passes, in megapixels per second.
+    double encodeRate(const GpuVideoBlockEncoder& encoder, const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& blocks, uint32_t threads, int passes) {
+        double best = 0.0;
+        for (int pass = 0; pass < passes; ++pass) {
+            Clock::time_point begin = Clock::now();
+            encoder.encode(rgba.data(), width, height, width * 4, blocks.data(), threads);
+            double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+            best = std::max(best, double(width) * height / 1.0e6 / std::max(seconds, 1.0e-9));
+        }
+        return best;
+    }
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    try {
+        std::vector<uint8_t> rgba = syntheticImage(options.width, options.height);
+        const GpuVideoBlockEncoder::Quality qualities[] = {
+            GpuVideoBlockEncoder::QUALITY_FAST, GpuVideoBlockEncoder::QUALITY_NORMAL, GpuVideoBlockEncoder::QUALITY_HIGH
+        };
+        const char* qualityNames[] = { "fast", "normal", "high" };
+
+        std::printf("%ux%u, format %u, best of %d passes, cpu supports %s\n", options.width, options.height,
+            (uint32_t)options.format, options.passes, GpuVideoBlockEncoder::isaName(GpuVideoBlockEncoder::bestIsa()));
+        std::printf("%-8s %-8s %12s %14s %10s %12s\n", "isa", "quality", "MPix/s 1T", "MPix/s all", "PSNR dB", "mismatches");
+
+        for (int q = 0; q < 3; ++q) {
+            GpuVideoBlockEncoder reference(options.format, qualities[q], GpuVideoBlockEncoder::ISA_SCALAR);
+            std::vector<uint8_t> expected(reference.getFrameBytes(options.width, options.height));
+            reference.encode(rgba.data(), options.width, options.height, options.width * 4, expected.data(), 1);
+
+            for (int isa = GpuVideoBlockEncoder::ISA_SCALAR; isa <= GpuVideoBlockEncoder::bestIsa(); ++isa) {
+                GpuVideoBlockEncoder encoder(options.format, qualities[q], static_cast<GpuVideoBlockEncoder::Isa>(isa));
+                std::vector<uint8_t> blocks(encoder.getFrameBytes(options.width, options.height));
+                double single = encodeRate(encoder, rgba, options.width, options.height, blocks, 1, options.passes);
+                double parallel = encodeRate(encoder, rgba, options.width, options.height, blocks, options.threads, options.passes);
+
+                uint32_t blockBytes = encoder.getBlockBytes();
+                uint32_t mismatches = 0;
+                for (size_t at = 0; at < blocks.size(); at += blockBytes) {
+                    mismatches += memcmp(&blocks[at], &expected[at], blockBytes) != 0;
+                }
+                double db = psnr(rgba, options.width, options.height, blocks, options.format);
+                std::printf("%-8s %-8s %12.1f %14.1f %10.2f %12u\n", GpuVideoBlockEncoder::isaName(encoder.getIsa()),
+                    qualityNames[q], single, parallel, db, mismatches);
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "error: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,230 @@
+//
+//  GpuVideoUploadBench.cpp
+//
+//  Streams a synthetic .gv file through GpuVideoStreamingTexture on a headless
+//  GL context and reports the upload timings of the client memory, PBO ring and
+//  persistently mapped (zero copy) paths, plus the On GPU Memory load time.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+#include "GpuVideoReaderMapped.h"
+#include "GpuVideoStreamingTexture.h"
+#include "GpuVideoOnGpuMemoryTexture.h"
+#include "HeadlessGL.h"
+#include "SyntheticGpuVideo.h"
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    struct UploadOptions {
+        SyntheticClip clip;
+        int passes = 3;
+        int pbos = 3;
+        int prefetch = 0;
+        double budgetMs = 4.0;
+        std::string path = "gpuvideo_upload_bench.gv";
+        bool keep = false;
+    };
+
+    struct UploadResult {
+        double cookMs = 0.0;
+        double p50Ms = 0.0;
+        double p99Ms = 0.0;
+        double copyMs = 0.0;
+        double submitMs = 0.0;
+        uint64_t orphaned = 0;
+        double framesPerSecond = 0.0;
+    };
+
+    double percentile(std::vector<double> samples, double p) {
+        if (samples.empty()) {
+            return 0.0;
+        }
+        std::size_t n = static_cast<std::size_t>(p * (samples.size() - 1) + 0.5);
+        std::nth_element(samples.begin(), samples.begin() + n, samples.end());
+        return samples[n];
+    }
+
+    UploadResult benchUpload(const UploadOptions& options, uint32_t pboCount, bool persistent) {
+        std::shared_ptr<IGpuVideoReader> reader = std::make_shared<GpuVideoReaderMapped>(options.path.c_str());
+        // Without prefetch decode runs inside updateCPU, so cook ms = decode + any copy + upload.
+        GpuVideoStreamingTexture texture(reader, GL_LINEAR, GL_CLAMP_TO_EDGE, options.prefetch, pboCount, persistent);
+        if (persistent && texture.isPersistent() == false) {
+            throw std::runtime_error("buffer storage unavailable");
+        }
+
+        UploadResult result;
+        std::vector<double> samples;
+        texture.setUploadHook([&](const GpuVideoUploadTiming& timing) {
+            samples.push_back(timing.waitMs + timing.copyMs + timing.submitMs);
+            result.copyMs += timing.copyMs;
+            result.submitMs += timing.submitMs;
+            result.orphaned += timing.orphaned ? 1 : 0;
+        });
+
+        std::vector<double> cooks;
+        Clock::time_point begin = Clock::now();
+        for (int pass = 0; pass < options.passes; ++pass) {
+            for (uint32_t i = 0; i < reader->getFrameCount(); ++i) {
+                Clock::time_point cook = Clock::now();
+                texture.updateCPU(static_cast<int>(i));
+                texture.uploadGPU();
+                cooks.push_back(std::chrono::duration<double, std::milli>(Clock::now() - cook).count());
+                glFlush();
+            }
+        }
+        glFinish();
+        double totalMs = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+
+        if (!samples.empty()) {
+            result.copyMs /= samples.size();
+            result.submitMs /= samples.size();
+        }
+        result.cookMs = percentile(cooks, 0.50);
+        result.p50Ms = percentile(samples, 0.50);
+        result.p99Ms = percentile(samples, 0.99);
+        result.framesPerSecond = totalMs > 0.0 ? samples.size() * 1000.0 / totalMs : 0.0;
+        return result;
+    }
+
+    // Whole-clip load into texture arrays, up to the point every layer is resident.
+    double benchOnGpuLoad(const UploadOptions& options, int* textureCount) {
+        std::shared_ptr<IGpuVideoReader> reader = std::make_shared<GpuVideoReaderMapped>(options.path.c_str());
+        Clock::time_point begin = Clock::now();
+        GpuVideoOnGpuMemoryTexture texture(reader, GL_LINEAR, GL_CLAMP_TO_EDGE);
+        glFinish();
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+        *textureCount = texture.getTextureCount();
+        return ms;
+    }
+
+    // The same load spread over cooks with a time budget, playing frames meanwhile, by nodes
+    // textures sharing one storage the way TOP instances on one file do.
+    int benchOnGpuIncremental(const UploadOptions& options, int nodes, double* worstCookMs) {
+        std::shared_ptr<IGpuVideoReader> reader = std::make_shared<GpuVideoReaderMapped>(options.path.c_str());
+        std::shared_ptr<GpuVideoOnGpuMemoryStorage> storage = std::make_shared<GpuVideoOnGpuMemoryStorage>(reader, GL_LINEAR, GL_CLAMP_TO_EDGE, true);
+        std::vector<std::unique_ptr<GpuVideoOnGpuMemoryTexture>> textures;
+        for (int i = 0; i < nodes; ++i) {
+            textures.emplace_back(new GpuVideoOnGpuMemoryTexture(storage));
+        }
+
+        int cooks = 0;
+        *worstCookMs = 0.0;
+        while (storage->isComplete() == false) {
+            Clock::time_point cook = Clock::now();
+            for (std::unique_ptr<GpuVideoOnGpuMemoryTexture>& texture : textures) {
+                texture->setUploadBudget(options.budgetMs, 0, cooks);
+                texture->updateCPU(cooks % static_cast<int>(reader->getFrameCount()));
+                texture->uploadGPU();
+            }
+            glFlush();
+            *worstCookMs = std::max(*worstCookMs, std::chrono::duration<double, std::milli>(Clock::now() - cook).count());
+            ++cooks;
+        }
+        glFinish();
+        return cooks;
+    }
+
+    bool parseOptions(int argc, char** argv, UploadOptions& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--keep") {
+                options.keep = true;
+            }
+            else if (arg == "--width" && hasValue) {
+                options.clip.width = static_cast<uint32_t>(std::atoi(argv[++i]));
+            }
+            else if (arg == "--height" && hasValue) {
+                options.clip.height = static_cast<uint32_t>(std::atoi(argv[++i]));
+            }
+            else if (arg == "--frames" && hasValue) {
+                options.clip.frames = static_cast<uint32_t>(std::atoi(argv[++i]));
+            }
+            else if (arg == "--format" && hasValue) {
+                options.clip.format = static_cast<GPU_COMPRESS>(std::atoi(argv[++i]));
+            }
+            else if (arg == "--passes" && hasValue) {
+                options.passes = std::atoi(argv[++i]);
+            }
+            else if (arg == "--pbos" && hasValue) {
+                options.pbos = std::atoi(argv[++i]);
+            }
+            else if (arg == "--prefetch" && hasValue) {
+                options.prefetch = std::atoi(argv[++i]);
+            }
+            else if (arg == "--budgetms" && hasValue) {
+                options.budgetMs = std::atof(argv[++i]);
+            }
+            else if (arg == "--file" && hasValue) {
+                options.path = argv[++i];
+            }
+            else {
+                return false;
+            }
+        }
+        return options.clip.width > 0 && options.clip.height > 0 && options.clip.frames > 0 && options.passes > 0 && options.pbos > 0 && options.prefetch >= 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    UploadOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        std::printf("usage: %s [--width N] [--height N] [--frames N] [--format 1|3|5|7] [--passes N] [--pbos N] [--prefetch N] [--budgetms F] [--file PATH] [--keep]\n", argv[0]);
+        return 1;
+    }
+
+    int status = 0;
+    try {
+        HeadlessGL gl;
+        writeSyntheticGpuVideo(options.path.c_str(), options.clip);
+
+        std::printf("%s, %s\n", (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION));
+        std::printf("%ux%u, %u frames, format %u, %d passes\n",
+            options.clip.width, options.clip.height, options.clip.frames, (uint32_t)options.clip.format, options.passes);
+        std::printf("%-24s %10s %10s %10s %10s %10s %10s %12s\n", "upload", "cook ms", "p50 ms", "p99 ms", "copy ms", "submit ms", "orphaned", "frames/sec");
+
+        struct Path {
+            const char* name;
+            uint32_t pbos;
+            bool persistent;
+        };
+        const Path paths[] = {
+            { "client memory", 0, false },
+            { "pbo ring", static_cast<uint32_t>(options.pbos), false },
+            { "persistent (zero copy)", static_cast<uint32_t>(options.pbos), true },
+        };
+        for (const Path& path : paths) {
+            UploadResult r = benchUpload(options, path.pbos, path.persistent);
+            std::printf("%-24s %10.3f %10.3f %10.3f %10.3f %10.3f %10llu %12.1f\n", path.name,
+                r.cookMs, r.p50Ms, r.p99Ms, r.copyMs, r.submitMs, (unsigned long long)r.orphaned, r.framesPerSecond);
+        }
+
+        int textureCount = 0;
+        double loadMs = benchOnGpuLoad(options, &textureCount);
+        std::printf("\non gpu memory load %.2f ms, %u frames in %d array textures\n", loadMs, options.clip.frames, textureCount);
+        double worstCookMs = 0.0;
+        for (int nodes : { 1, 4 }) {
+            int cooks = benchOnGpuIncremental(options, nodes, &worstCookMs);
+            std::printf("incremental, %g ms budget, %d node(s): %d cooks, worst cook %.2f ms\n", options.budgetMs, nodes, cooks, worstCookMs);
+        }
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "error: %s\n", e.what());
+        status = 1;
+    }
+
+    if (!options.keep) {
+        std::remove(options.path.c_str());
+    }
+    return status;
+}
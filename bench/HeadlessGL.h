@@ -0,0 +1,51 @@
+//
+//  HeadlessGL.h
+//
+//  Surfaceless EGL desktop GL context (e.g. Mesa llvmpipe) for GL benchmarks.
+//
+
+#pragma once
+
+#include <stdexcept>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+class HeadlessGL {
+public:
+    HeadlessGL() {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        _display = getPlatformDisplay ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr) : EGL_NO_DISPLAY;
+        if (_display == EGL_NO_DISPLAY) {
+            _display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        }
+        EGLint major = 0, minor = 0;
+        if (_display == EGL_NO_DISPLAY || eglInitialize(_display, &major, &minor) == EGL_FALSE) {
+            throw std::runtime_error("eglInitialize failed");
+        }
+        eglBindAPI(EGL_OPENGL_API);
+
+        const EGLint attributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 4,
+            EGL_CONTEXT_MINOR_VERSION, 5,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        _context = eglCreateContext(_display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+        if (_context == EGL_NO_CONTEXT || eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, _context) == EGL_FALSE) {
+            eglTerminate(_display);
+            throw std::runtime_error("no surfaceless GL 4.5 context");
+        }
+    }
+    ~HeadlessGL() {
+        eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(_display, _context);
+        eglTerminate(_display);
+    }
+
+    HeadlessGL(const HeadlessGL&) = delete;
+    void operator=(const HeadlessGL&) = delete;
+private:
+    EGLDisplay _display = EGL_NO_DISPLAY;
+    EGLContext _context = EGL_NO_CONTEXT;
+};
@@ -0,0 +1,78 @@
+//
+//  SyntheticGpuVideo.h
+//
+//  Writes deterministic .gv files for the benchmarks.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "GpuVideo.h"
+#include "GpuVideoWriter.h"
+
+struct SyntheticClip {
+    uint32_t width = 1920;
+    uint32_t height = 1080;
+    uint32_t frames = 240;
+    float fps = 30.0f;
+    GPU_COMPRESS format = GPU_COMPRESS_DXT5;
+    // block rows per LZ4 strip, 0 = one block per frame
+    uint32_t stripRows = 0;
+};
+
+inline uint32_t syntheticBlockBytes(GPU_COMPRESS format) {
+    return format == GPU_COMPRESS_DXT1 ? 8 : 16;
+}
+
+inline uint32_t syntheticFrameBytes(const SyntheticClip& clip) {
+    return ((clip.width + 3) / 4) * ((clip.height + 3) / 4) * syntheticBlockBytes(clip.format);
+}
+
+inline uint32_t syntheticHash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+// BCn-like payload with runs of identical blocks so LZ4 sees a
+// compression ratio in the range of real footage.
+inline void fillSyntheticFrame(uint8_t* dst, const SyntheticClip& clip, uint32_t frame) {
+    uint32_t bw = (clip.width + 3) / 4;
+    uint32_t bh = (clip.height + 3) / 4;
+    uint32_t bytes = syntheticBlockBytes(clip.format);
+    for (uint32_t by = 0; by < bh; ++by) {
+        for (uint32_t bx = 0; bx < bw; ++bx) {
+            uint32_t coarse = syntheticHash(((bx + frame * 2) / 8) * 7919u + (by / 8) * 104729u);
+            uint32_t fine = syntheticHash(bx * 31u + by * 17u + frame);
+            bool flat = (coarse & 3) != 0;
+            for (uint32_t i = 0; i < bytes; ++i) {
+                uint32_t v = (i < 4 || flat) ? coarse >> (i % 4 * 8) : fine >> (i % 4 * 8);
+                dst[i] = static_cast<uint8_t>(v);
+            }
+            dst += bytes;
+        }
+    }
+}
+
+// Plain LZ4 like the original encoder. v1 unless strips are asked for,
+// so the benchmarks keep covering the original layout.
+inline void writeSyntheticGpuVideo(const char* path, const SyntheticClip& clip) {
+    GpuVideoEncodeSettings settings;
+    settings.width = clip.width;
+    settings.height = clip.height;
+    settings.fps = clip.fps;
+    settings.format = clip.format;
+    settings.level = 0;
+    settings.version = clip.stripRows != 0 ? kGpuVideoVersion : 1;
+    settings.stripRows = clip.stripRows;
+    GpuVideoWriter writer(path, settings);
+    writer.encode(clip.frames, [&clip](uint8_t* dst, uint32_t frame) {
+        fillSyntheticFrame(dst, clip, frame);
+    });
+}
@@ -2,6 +2,10 @@
 
 #include <assert.h>
 #include <cstdio>
+#include <stdexcept>
+
+// Nodes alive in this process; the shared thread pool goes with the last one.
+static std::atomic<int> instanceCount(0);
 
 // These functions are basic C function, which the DLL loader can find
 // much easier than finding a C++ Class.
@@ -17,7 +21,11 @@ extern "C"
 		info->apiVersion = TOPCPlusPlusAPIVersion;
 
 		// Change this to change the executeMode behavior of this plugin.
+#ifdef EX_GPU_VIDEO_CPU_OUTPUT
+		info->executeMode = TOP_ExecuteMode::CPUMemWriteOnly;
+#else
 		info->executeMode = TOP_ExecuteMode::OpenGL_FBO;
+#endif
 
 		// The opType is the unique name for this TOP. It must start with a 
 		// capital A-Z character, and all the following characters must lower case
@@ -49,6 +57,7 @@ extern "C"
 
 		// Note we can't do any OpenGL work during instantiation
 
+		++instanceCount;
 		return new ExGpuVideoTOP(info, context);
 	}
 
@@ -62,11 +71,24 @@ extern "C"
 
 		// We do some OpenGL teardown on destruction, so ask the TOP_Context
 		// to set up our OpenGL context
+#ifdef EX_GPU_VIDEO_CPU_OUTPUT
+		delete (ExGpuVideoTOP*)instance;
+#else
 		context->beginGLCommands();
 
 		delete (ExGpuVideoTOP*)instance;
 
 		context->endGLCommands();
+#endif
+
+		// The workers must be gone before the DLL can be unloaded, and joining them from its
+		// static destructors can deadlock. The next node to load starts new ones.
+		if (--instanceCount == 0)
+		{
+			// Completed reads go through the pool, so the engine goes first.
+			GpuVideoFetchEngine::shutdownShared();
+			GpuVideoThreadPool::shutdownShared();
+		}
 	}
 
 };
@@ -79,12 +101,30 @@ ExGpuVideoTOP::ExGpuVideoTOP(const OP_NodeInfo* info, TOP_Context* context)
 	, height_(0.f)
 	, exec_count_(0)
 	, frame_(0.f)
+	, clock_seconds_(0.0)
+	, seek_requested_(false)
 	, fps_(0.f)
 	, frame_count_(0)
 	, filepath(nullptr)
+	, decode_threads_(0)
+	, verify_(GPU_VIDEO_VERIFY_OFF)
+	, prefetch_depth_(4)
+	, coalesce_frames_(8)
+	, zero_copy_(false)
+	, direct_io_(false)
+	, upload_budget_ms_(4.0)
+	, upload_budget_mb_(0.0)
+	, cache_mb_(0.0)
+	, load_pending_(false)
+	, reload_requested_(false)
+	, unload_requested_(false)
+	, load_state_(LOAD_IDLE)
+	, load_elapsed_(0.0)
 	, reader_(nullptr)
 	, video_texture_(nullptr)
+	, shader_err(nullptr)
 {
+#ifndef EX_GPU_VIDEO_CPU_OUTPUT
 
 	static bool needGLEWInit = true;
 	if (needGLEWInit)
@@ -101,10 +141,17 @@ ExGpuVideoTOP::ExGpuVideoTOP(const OP_NodeInfo* info, TOP_Context* context)
 	context->beginGLCommands();
 	setupGL();
 	context->endGLCommands();
+#endif
 }
 
 ExGpuVideoTOP::~ExGpuVideoTOP()
-{}
+{
+	if (thread_)
+	{
+		load_job_->cancelled = true;
+		thread_->join();
+	}
+}
 
 void ExGpuVideoTOP::getGeneralInfo(TOP_GeneralInfo* ginfo, const OP_Inputs* inputs, void* reserved1)
 {
@@ -112,6 +159,9 @@ void ExGpuVideoTOP::getGeneralInfo(TOP_GeneralInfo* ginfo, const OP_Inputs* inpu
 	// if none of its inputs/parameters are changing. Set it to false if it
 	// only needs to cook when inputs/parameters change.
 	ginfo->cookEveryFrameIfAsked = true;
+#ifdef EX_GPU_VIDEO_CPU_OUTPUT
+	ginfo->memPixelType = OP_CPUMemPixelType::RGBA8Fixed;
+#endif
 }
 
 bool ExGpuVideoTOP::getOutputFormat(TOP_OutputFormat* format, const OP_Inputs* inputs, void* reserved1)
@@ -120,11 +170,37 @@ bool ExGpuVideoTOP::getOutputFormat(TOP_OutputFormat* format, const OP_Inputs* i
 	// the pixel format/resolution etc that we want to output to.
 	// If we did that, we'd want to return true to tell the TOP to use the settings we've
 	// specified.
-	// In this example we'll return false and use the TOP's settings
+	// The CPU output is decoded at the video's own resolution; the GL path
+	// scales to whatever the TOP's settings ask for.
+#ifdef EX_GPU_VIDEO_CPU_OUTPUT
+	if (isLoaded_)
+	{
+		format->width = width_;
+		format->height = height_;
+		return true;
+	}
+#endif
 	return false;
 }
 
 
+// Readers shared between instances share one mode: the last instance to cook sets it.
+static void applyVerify(const std::shared_ptr<IGpuVideoReader>& reader, GpuVideoVerify mode)
+{
+	std::shared_ptr<GpuVideoIntegrity> integrity = reader->getIntegrity();
+	if (integrity)
+	{
+		integrity->setMode(mode);
+	}
+}
+
+// A shared reader keeps whatever the instance that opened it asked for unless reapplied.
+static void applyReadSettings(const std::shared_ptr<GpuVideoReader>& reader, int decodeThreads, int coalesceFrames)
+{
+	reader->setDecodeThreads(decodeThreads);
+	reader->setCoalesceFrames(coalesceFrames);
+}
+
 void ExGpuVideoTOP::execute(TOP_OutputFormatSpecs* outputFormat, 
 							const OP_Inputs* inputs,
 							TOP_Context* context, 
@@ -138,31 +214,95 @@ void ExGpuVideoTOP::execute(TOP_OutputFormatSpecs* outputFormat,
 	filepath = inputs->getParFilePath("File");
 	float speed = inputs->getParDouble("Speed");
 
+	// Absolute time rather than per-cook steps: independent of the cook rate and of dropped cooks.
+	const OP_TimeInfo* time = inputs->getTimeInfo();
+	if (time->rootRate > 0.0)
+	{
+		clock_seconds_ = (double)time->absFrame / time->rootRate;
+	}
+	decode_threads_ = inputs->getParInt("Decodethreads");
+	verify_ = (GpuVideoVerify)inputs->getParInt("Verify");
+	if (reader_)
+	{
+		applyVerify(reader_, verify_);
+	}
+	prefetch_depth_ = inputs->getParInt("Prefetchdepth");
+	coalesce_frames_ = inputs->getParInt("Coalesceframes");
+	if (file_reader_)
+	{
+		applyReadSettings(file_reader_, decode_threads_, coalesce_frames_);
+	}
+	zero_copy_ = inputs->getParInt("Zerocopy") != 0;
+	direct_io_ = inputs->getParInt("Directio") != 0;
+	upload_budget_ms_ = inputs->getParDouble("Uploadbudgetms");
+	upload_budget_mb_ = inputs->getParDouble("Uploadbudgetmb");
+	cache_mb_ = inputs->getParDouble("Cachemb");
+	if (cache_)
+	{
+		cache_->setBudgetBytes((uint64_t)(cache_mb_ * 1024.0 * 1024.0));
+	}
+
 	current = std::string(filepath);
-	if (current != previous)
+	if (current != previous || reload_requested_)
 	{
-		load();
+		requestLoad();
 	}
 	previous = current;
+	reload_requested_ = false;
+
+#ifdef EX_GPU_VIDEO_CPU_OUTPUT
+	if (unload_requested_)
+	{
+		unload();
+		unload_requested_ = false;
+	}
+	updateLoad();
+	executeCPU(outputFormat, speed);
+	updateStats();
+	exec_count_++;
+	return;
+#endif
 
 	context->beginGLCommands();
+
+	if (unload_requested_)
+	{
+		unload();
+		unload_requested_ = false;
+	}
+	updateLoad();
+
 	glViewport(0, 0, w, h);
 	glClearColor(0.0, 0.0, 0.0, 0.0);
 	glClear(GL_COLOR_BUFFER_BIT);
 
 	if (isLoaded_)
 	{
-		frame_ += fps_ / 30.f * speed;
-		frame_ = std::fmodf(frame_, (float)frame_count_ - 1.f);
+		if (seek_requested_)
+		{
+			clock_.seek(0.0, clock_seconds_);
+			seek_requested_ = false;
+		}
+		clock_.setSpeed(speed, clock_seconds_);
+		frame_ = (float)clock_.update(clock_seconds_);
 
+		// Nodes sharing one clip's GPU storage share this budget per timeline frame.
+		video_texture_->setUploadBudget(upload_budget_ms_, (uint64_t)(upload_budget_mb_ * 1024.0 * 1024.0), time->absFrame);
 		video_texture_->updateCPU(frame_);
 		video_texture_->uploadGPU();
+		updateUpload();
 
-		glUseProgram(shader_prg.getName());
+		GLenum target = video_texture_->getTarget();
+		GLuint program = target == GL_TEXTURE_2D_ARRAY ? shader_array_prg.getName() : shader_prg.getName();
+		glUseProgram(program);
 
 		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, video_texture_->getTexture());
-		glUniform1i(glGetUniformLocation(shader_prg.getName(), "u_src"), 0);
+		glBindTexture(target, video_texture_->getTexture());
+		glUniform1i(glGetUniformLocation(program, "u_src"), 0);
+		if (target == GL_TEXTURE_2D_ARRAY)
+		{
+			glUniform1i(glGetUniformLocation(program, "u_layer"), video_texture_->getLayer());
+		}
 
 		glBindVertexArray(vao);
 		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
@@ -172,25 +312,197 @@ void ExGpuVideoTOP::execute(TOP_OutputFormatSpecs* outputFormat,
 
 	context->endGLCommands();
 
+	updateStats();
 	exec_count_++;
 }
 
+// Decodes the current frame straight into TouchDesigner's upload memory; no GL.
+void ExGpuVideoTOP::executeCPU(TOP_OutputFormatSpecs* outputFormat, float speed)
+{
+	outputFormat->newCPUPixelDataLocation = -1;
+	if (!isLoaded_ || outputFormat->width != width_ || outputFormat->height != height_)
+	{
+		// The resolution from getOutputFormat() takes effect on the next cook.
+		return;
+	}
+
+	if (seek_requested_)
+	{
+		clock_.seek(0.0, clock_seconds_);
+		seek_requested_ = false;
+	}
+	clock_.setSpeed(speed, clock_seconds_);
+	frame_ = (float)clock_.update(clock_seconds_);
+
+	GpuVideoPrefetcher::Lease lease = cpu_prefetcher_->acquire((int)frame_);
+	if (lease.slot < 0)
+	{
+		return;
+	}
+	// Row 0 of the video is its top; TouchDesigner's memory starts at the bottom.
+	ptrdiff_t stride = (ptrdiff_t)width_ * 4;
+	uint8_t* top = (uint8_t*)outputFormat->cpuPixelData[0] + stride * (height_ - 1);
+	{
+		// The software decode is this build's upload.
+		GpuVideoStageTimer::Scope timer(upload_timer_);
+		block_decoder_->decode(lease.data, width_, height_, top, -stride, decode_threads_);
+	}
+	cpu_prefetcher_->release(lease.slot);
+	outputFormat->newCPUPixelDataLocation = 0;
+}
+
 int32_t ExGpuVideoTOP::getNumInfoCHOPChans(void* reserved1)
 {
 	// We return the number of channel we want to output to any Info CHOP
-	// connected to the TOP. In this example we are just going to send one channel.
-	return 0;
+	// connected to the TOP.
+	return 22;
 }
 
 void ExGpuVideoTOP::getInfoCHOPChan(int32_t index, OP_InfoCHOPChan* chan, void* reserved1)
 {
 	// This function will be called once for each channel we said we'd want to return
-	// In this example it'll only be called once.
+	if (index == 0)
+	{
+		chan->name->setString("loadState");
+		chan->value = (float)loadState();
+	}
+
+	if (index == 1)
+	{
+		chan->name->setString("loadProgress");
+		chan->value = loadProgress();
+	}
+
+	if (index == 2)
+	{
+		chan->name->setString("residentFrames");
+		chan->value = video_texture_ ? video_texture_->getUploadProgress() * (float)frame_count_ : 0.f;
+	}
+
+	if (index == 3)
+	{
+		chan->name->setString("droppedFrames");
+		chan->value = (float)clock_.getDroppedFrames();
+	}
+
+	if (index == 4)
+	{
+		chan->name->setString("repeatedFrames");
+		chan->value = (float)clock_.getRepeatedFrames();
+	}
+
+	if (index == 5)
+	{
+		chan->name->setString("cacheHits");
+		chan->value = cache_ ? (float)cache_->getHits() : 0.f;
+	}
+
+	if (index == 6)
+	{
+		chan->name->setString("cacheMisses");
+		chan->value = cache_ ? (float)cache_->getMisses() : 0.f;
+	}
+
+	if (index == 7)
+	{
+		chan->name->setString("cacheEvictions");
+		chan->value = cache_ ? (float)cache_->getEvictions() : 0.f;
+	}
+
+	std::shared_ptr<GpuVideoIntegrity> integrity = reader_ ? reader_->getIntegrity() : nullptr;
+	if (index == 8)
+	{
+		chan->name->setString("checkedFrames");
+		chan->value = integrity ? (float)integrity->getCheckedCount() : 0.f;
+	}
+
+	if (index == 9)
+	{
+		chan->name->setString("corruptFrames");
+		chan->value = integrity ? (float)integrity->getCorruptCount() : 0.f;
+	}
+
+	const GpuVideoPrefetcher* prefetcher = activePrefetcher();
+	if (index == 10)
+	{
+		chan->name->setString("lateFrames");
+		chan->value = prefetcher ? (float)prefetcher->getLateFrames() : 0.f;
+	}
+
+	if (index == 11)
+	{
+		chan->name->setString("droppedDecodes");
+		chan->value = prefetcher ? (float)prefetcher->getDroppedFrames() : 0.f;
+	}
+
+	if (index == 12)
+	{
+		chan->name->setString("currentFrame");
+		chan->value = isLoaded_ ? frame_ : 0.f;
+	}
+
+	if (index == 13)
+	{
+		chan->name->setString("frameCount");
+		chan->value = isLoaded_ ? (float)frame_count_ : 0.f;
+	}
+
+	if (index == 14)
+	{
+		chan->name->setString("fps");
+		chan->value = isLoaded_ ? fps_ : 0.f;
+	}
+
+	// Mean per frame over the last cook, or the cook before that when nothing happened.
+	if (index == 15)
+	{
+		chan->name->setString("ioMs");
+		chan->value = (float)io_window_.getMeanMs();
+	}
+
+	if (index == 16)
+	{
+		chan->name->setString("decodeMs");
+		chan->value = (float)decode_window_.getMeanMs();
+	}
+
+	if (index == 17)
+	{
+		chan->name->setString("uploadMs");
+		chan->value = (float)upload_window_.getMeanMs();
+	}
+
+	if (index == 18)
+	{
+		chan->name->setString("cacheHitRate");
+		uint64_t lookups = cache_ ? cache_->getHits() + cache_->getMisses() : 0;
+		chan->value = lookups == 0 ? 0.f : (float)cache_->getHits() / (float)lookups;
+	}
+
+	if (index == 19)
+	{
+		chan->name->setString("prefetchDepth");
+		chan->value = prefetcher ? (float)prefetcher->getReadyFrames() : 0.f;
+	}
+
+	if (index == 20)
+	{
+		chan->name->setString("residentCpuBytes");
+		uint64_t bytes = reader_ ? reader_->getResidentBytes() : 0;
+		bytes += prefetcher ? prefetcher->getResidentBytes() : 0;
+		chan->value = (float)bytes;
+	}
+
+	if (index == 21)
+	{
+		chan->name->setString("residentGpuBytes");
+		chan->value = video_texture_ ? (float)video_texture_->getGpuBytes() : 0.f;
+	}
 }
 
 bool ExGpuVideoTOP::getInfoDATSize(OP_InfoDATSize* infoSize, void* reserved1)
 {
-	infoSize->rows = 2;
+	infoSize->rows = 7;
 	infoSize->cols = 2;
 	// Setting this to false means we'll be assigning values to the table
 	// one row at a time. True means we'll do it one column at a time.
@@ -198,6 +510,20 @@ bool ExGpuVideoTOP::getInfoDATSize(OP_InfoDATSize* infoSize, void* reserved1)
 	return true;
 }
 
+static const char* loadStateName(LoadState state)
+{
+	switch (state)
+	{
+		case LOAD_IDLE:			return "idle";
+		case LOAD_OPENING:		return "opening";
+		case LOAD_DECODING:		return "decoding";
+		case LOAD_UPLOADING:	return "uploading";
+		case LOAD_READY:		return "ready";
+		case LOAD_FAILED:		return "failed";
+	}
+	return "";
+}
+
 void ExGpuVideoTOP::getInfoDATEntries(int32_t index,
 	int32_t nEntries,
 	OP_InfoDATEntries* entries,
@@ -213,13 +539,99 @@ void ExGpuVideoTOP::getInfoDATEntries(int32_t index,
 		sprintf_s(tempBuffer, "%d", exec_count_);
 		entries->values[1]->setString(tempBuffer);
 	}
+
+	if (index == 1)
+	{
+		strcpy_s(tempBuffer, "loadState");
+		entries->values[0]->setString(tempBuffer);
+
+		strcpy_s(tempBuffer, loadStateName(loadState()));
+		entries->values[1]->setString(tempBuffer);
+	}
+
+	if (index == 2)
+	{
+		strcpy_s(tempBuffer, "loadProgress");
+		entries->values[0]->setString(tempBuffer);
+
+		sprintf_s(tempBuffer, "%g", loadProgress());
+		entries->values[1]->setString(tempBuffer);
+	}
+
+	if (index == 3)
+	{
+		strcpy_s(tempBuffer, "loadElapsed");
+		entries->values[0]->setString(tempBuffer);
+
+		sprintf_s(tempBuffer, "%g", loadElapsed());
+		entries->values[1]->setString(tempBuffer);
+	}
+
+	if (index == 4)
+	{
+		strcpy_s(tempBuffer, "sharedObjects");
+		entries->values[0]->setString(tempBuffer);
+
+		sprintf_s(tempBuffer, "%d", (int)GpuVideoClipRegistry::getLiveCount());
+		entries->values[1]->setString(tempBuffer);
+	}
+
+	std::shared_ptr<GpuVideoIntegrity> integrity = reader_ ? reader_->getIntegrity() : nullptr;
+	if (index == 5)
+	{
+		strcpy_s(tempBuffer, "scrubProgress");
+		entries->values[0]->setString(tempBuffer);
+
+		sprintf_s(tempBuffer, "%g", integrity ? integrity->getScrubProgress() : 0.f);
+		entries->values[1]->setString(tempBuffer);
+	}
+
+	if (index == 6)
+	{
+		strcpy_s(tempBuffer, "corruptFrames");
+		entries->values[0]->setString(tempBuffer);
+
+		// Space separated frame numbers, as many as fit.
+		tempBuffer[0] = 0;
+		if (integrity)
+		{
+			size_t used = 0;
+			for (int frame : integrity->getCorruptFrames())
+			{
+				int n = snprintf(tempBuffer + used, sizeof(tempBuffer) - used, used == 0 ? "%d" : " %d", frame);
+				if (n < 0 || used + n >= sizeof(tempBuffer))
+				{
+					tempBuffer[used] = 0;
+					break;
+				}
+				used += n;
+			}
+		}
+		entries->values[1]->setString(tempBuffer);
+	}
 }
 
 void ExGpuVideoTOP::getErrorString(OP_String* error, void* reserved1)
 {
+	if (shader_err == nullptr && load_state_ == LOAD_FAILED)
+	{
+		error->setString(load_error_.c_str());
+		return;
+	}
 	error->setString(shader_err);
 }
 
+void ExGpuVideoTOP::getWarningString(OP_String* warning, void* reserved1)
+{
+	std::shared_ptr<GpuVideoIntegrity> integrity = reader_ ? reader_->getIntegrity() : nullptr;
+	if (integrity && integrity->getCorruptCount() > 0)
+	{
+		std::vector<int> frames = integrity->getCorruptFrames();
+		warning_ = std::to_string(frames.size()) + " corrupt frame(s), shown black; first is " + std::to_string(frames.empty() ? -1 : frames.front());
+		warning->setString(warning_.c_str());
+	}
+}
+
 void ExGpuVideoTOP::setupParameters(OP_ParameterManager* manager, void* reserved1)
 {
 
@@ -243,7 +655,7 @@ void ExGpuVideoTOP::setupParameters(OP_ParameterManager* manager, void* reserved
 		np.name = "Speed";
 		np.label = "Speed";
 		np.page = "Play";
-		np.defaultValues[0] = 0.5;
+		np.defaultValues[0] = 1.0;
 		np.minSliders[0] = 0.0;
 		np.maxSliders[0] = 2.0;
 
@@ -267,6 +679,149 @@ void ExGpuVideoTOP::setupParameters(OP_ParameterManager* manager, void* reserved
 		assert(res == OP_ParAppendResult::Success);
 	}
 
+	// decode threads
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Decodethreads";
+		np.label = "Decode Threads";
+		np.page = "Play";
+		np.defaultValues[0] = 0;
+		np.minValues[0] = 0;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 0;
+		np.maxSliders[0] = 32;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// checksum verification
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Verify";
+		sp.label = "Verify Checksums";
+		sp.page = "Play";
+		sp.defaultValue = "Off";
+
+		const char* names[] = { "Off", "Firstdecode", "Scrub" };
+		const char* labels[] = { "Off", "On First Decode", "Background Scrub" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 3, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// prefetch depth
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Prefetchdepth";
+		np.label = "Prefetch Depth";
+		np.page = "Play";
+		np.defaultValues[0] = 4;
+		np.minValues[0] = 0;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 0;
+		np.maxSliders[0] = 16;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// merged reads for forward playback (Streaming From Storage)
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Coalesceframes";
+		np.label = "Coalesce Reads (frames)";
+		np.page = "Play";
+		np.defaultValues[0] = 8;
+		np.minValues[0] = 0;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 0;
+		np.maxSliders[0] = 32;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// zero copy upload
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Zerocopy";
+		np.label = "Zero Copy Upload";
+		np.page = "Play";
+		np.defaultValues[0] = 0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// unbuffered reads (Streaming From Storage, On GPU Memory)
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Directio";
+		np.label = "Direct I/O";
+		np.page = "Play";
+		np.defaultValues[0] = 0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// decoded frame cache (streaming from storage / CPU memory)
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Cachemb";
+		np.label = "Frame Cache (MB)";
+		np.page = "Play";
+		np.defaultValues[0] = 0.0;
+		np.minValues[0] = 0.0;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 4096.0;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// upload budget (On GPU Memory)
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Uploadbudgetms";
+		np.label = "Upload Budget (ms)";
+		np.page = "Play";
+		np.defaultValues[0] = 4.0;
+		np.minValues[0] = 0.0;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 16.0;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Uploadbudgetmb";
+		np.label = "Upload Budget (MB)";
+		np.page = "Play";
+		np.defaultValues[0] = 0.0;
+		np.minValues[0] = 0.0;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 256.0;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
 	// Load pulse
 	{
 		OP_NumericParameter	np;
@@ -308,109 +863,318 @@ void ExGpuVideoTOP::setupParameters(OP_ParameterManager* manager, void* reserved
 
 void ExGpuVideoTOP::pulsePressed(const char* name, void* reserved1)
 {
+	// GL work is deferred to execute(), where the TOP_Context is available.
 	if (strcmp(name, "Reload") == 0)
 	{
-		std::string path(filepath);
-		std::string ext(".gv");
-		if (path.size() >= ext.size() &&
-			path.find(ext, path.size() - ext.size()) != std::string::npos)
-		{
-			unload();
-			load();
-		}
+		reload_requested_ = true;
 	}
 
 	if (strcmp(name, "Position") == 0)
 	{
-		frame_ = 0.f;
+		seek_requested_ = true;
 	}
 
 	if (strcmp(name, "Unload") == 0 && isLoaded_)
 	{
-		unload();
+		unload_requested_ = true;
 	}
 }
 
 
-void ExGpuVideoTOP::load() 
+void ExGpuVideoTOP::requestLoad()
 {
-	std::string path(filepath);
 	std::string ext(".gv");
-	if (path.size() < ext.size() || path.find(ext, path.size() - ext.size()) == std::string::npos) {
+	if (current.size() < ext.size() || current.find(ext, current.size() - ext.size()) == std::string::npos) {
 		return;
 	}
-	switch (mode_)
+
+	// One load at a time; a request made meanwhile restarts once the running job is collected.
+	if (load_job_)
 	{
-		case GPU_VIDEO_STREAMING_FROM_STORAGE:
-		{
-			thread_ = std::make_unique<std::thread>([this]() {
-				reader_ = std::make_shared<GpuVideoReader>(filepath, false);
-			});
-			thread_->join();
-			video_texture_ = std::make_unique<GpuVideoStreamingTexture>(reader_, GL_LINEAR, GL_CLAMP_TO_EDGE);
-			break;
-		}
+		load_job_->cancelled = true;
+		load_pending_ = true;
+		return;
+	}
+	startLoad();
+}
 
-		case GPU_VIDEO_STREAMING_FROM_CPU_MEMORY:
+void ExGpuVideoTOP::startLoad()
+{
+	std::shared_ptr<LoadJob> job = std::make_shared<LoadJob>();
+	job->path = current;
+	job->mode = mode_;
+	job->decodeThreads = decode_threads_;
+	job->verify = verify_;
+	job->directIO = direct_io_;
+	job->coalesceFrames = coalesce_frames_;
+	job->state = LOAD_OPENING;
+	job->cancelled = false;
+	job->decodedFrames = 0;
+	job->totalFrames = 0;
+	job->started = std::chrono::steady_clock::now();
+
+	load_job_ = job;
+	load_state_ = LOAD_OPENING;
+
+	// A thread of its own: opening and reading the file blocks, which pool tasks must not.
+	// Decoding a whole clip still goes through the pool, a chunk at a time behind any frame that is due.
+	thread_ = std::make_unique<std::thread>([job]() {
+		auto checkCancelled = [&job]() {
+			if (job->cancelled)
+			{
+				throw std::runtime_error("load cancelled");
+			}
+		};
+		try
 		{
-			thread_ = std::make_unique<std::thread>([this]() {
-				reader_ = std::make_shared<GpuVideoReader>(filepath, true);
-			});
-			thread_->join();
-			video_texture_ = std::make_unique<GpuVideoStreamingTexture>(reader_, GL_LINEAR, GL_CLAMP_TO_EDGE);
-			break;
+			// Instances playing the same file share what is built from it; each keeps its own playhead.
+			job->file = GpuVideoFileIdentity::of(job->path.c_str());
+			checkCancelled();
+			switch (job->mode)
+			{
+				case GPU_VIDEO_STREAMING_FROM_STORAGE:
+				case GPU_VIDEO_ON_GPU_MEMORY:
+				{
+					job->fileReader = GpuVideoClipRegistry::acquire<GpuVideoReader>(job->file, job->directIO ? "storage-direct" : "storage", [&job]() {
+						std::shared_ptr<GpuVideoReader> reader = std::make_shared<GpuVideoReader>(job->file.path.c_str(), false, job->directIO);
+						applyVerify(reader, job->verify);
+						return reader;
+					});
+					applyReadSettings(job->fileReader, job->decodeThreads, job->coalesceFrames);
+					job->reader = job->fileReader;
+					break;
+				}
+
+				case GPU_VIDEO_STREAMING_FROM_CPU_MEMORY:
+				{
+					// Read-ahead hints follow one playhead, so only the mapping underneath is shared.
+					std::shared_ptr<GpuVideoReaderMapped> reader = std::make_shared<GpuVideoReaderMapped>(job->file.path.c_str());
+					reader->setDecodeThreads(job->decodeThreads);
+					applyVerify(reader, job->verify);
+					job->reader = reader;
+					break;
+				}
+
+				case GPU_VIDEO_STREAMING_FROM_CPU_MEMORY_DECOMPRESSED:
+				{
+					job->state = LOAD_DECODING;
+					job->reader = GpuVideoClipRegistry::acquire<IGpuVideoReader>(job->file, "decompressed", [&job, &checkCancelled]() {
+						std::shared_ptr<IGpuVideoReader> source = std::make_shared<GpuVideoReader>(job->file.path.c_str(), false);
+						job->totalFrames = source->getFrameCount();
+						// Every frame is decoded here, so this is the only chance to check them.
+						applyVerify(source, job->verify);
+						checkCancelled();
+						return std::make_shared<GpuVideoReaderDecompressed>(source, job->decodeThreads, &job->decodedFrames, &job->cancelled);
+					});
+					break;
+				}
+			}
+			checkCancelled();
+			job->state = LOAD_UPLOADING;
 		}
-
-		case GPU_VIDEO_STREAMING_FROM_CPU_MEMORY_DECOMPRESSED:
+		catch (const std::exception& e)
 		{
-			thread_ = std::make_unique<std::thread>([this]() {
-				reader_ = std::make_shared<GpuVideoReaderDecompressed>(std::make_shared<GpuVideoReader>(filepath, false));
-			});
-			thread_->join();
-			video_texture_ = std::make_unique<GpuVideoStreamingTexture>(reader_, GL_LINEAR, GL_CLAMP_TO_EDGE);
-			break;
+			job->error = e.what();
+			job->state = LOAD_FAILED;
 		}
+	});
+}
 
-		case GPU_VIDEO_ON_GPU_MEMORY:
-		{
-			thread_ = std::make_unique<std::thread>([this]() {
-				reader_ = std::make_shared<GpuVideoReader>(filepath, false);
-			});
-			thread_->join();
-			video_texture_ = std::make_unique<GpuVideoOnGpuMemoryTexture>(reader_, GL_LINEAR, GL_CLAMP_TO_EDGE);
-			break;
-		}
+// Called every cook with GL commands enabled: collects a finished background job,
+// creates its texture and swaps it in.
+void ExGpuVideoTOP::updateLoad()
+{
+	if (!load_job_)
+	{
+		return;
+	}
+
+	std::shared_ptr<LoadJob> job = load_job_;
+	LoadState state = (LoadState)job->state.load();
+	if (state == LOAD_OPENING || state == LOAD_DECODING)
+	{
+		return;
 	}
 
+	thread_->join();
+	thread_.reset();
+	load_job_.reset();
+
+	if (load_pending_)
+	{
+		// Superseded while in flight.
+		load_pending_ = false;
+		startLoad();
+		return;
+	}
+
+	if (state == LOAD_FAILED)
+	{
+		load_state_ = LOAD_FAILED;
+		load_error_ = job->error;
+		load_elapsed_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - job->started).count();
+		return;
+	}
+
+	load_state_ = LOAD_UPLOADING;
+	std::shared_ptr<GpuVideoReaderCached> cache;
+	if (job->mode == GPU_VIDEO_STREAMING_FROM_STORAGE || job->mode == GPU_VIDEO_STREAMING_FROM_CPU_MEMORY)
+	{
+		// Always wrapped so the budget can be raised from zero while playing.
+		cache = std::make_shared<GpuVideoReaderCached>(job->reader, (uint64_t)(cache_mb_ * 1024.0 * 1024.0));
+		job->reader = cache;
+	}
+
+#ifdef EX_GPU_VIDEO_CPU_OUTPUT
+	// Every mode streams into the decoder; On GPU Memory has nothing to keep resident.
+	block_decoder_ = std::make_unique<GpuVideoBlockDecoder>(job->reader->getFormat());
+	cpu_prefetcher_ = std::make_unique<GpuVideoPrefetcher>(job->reader, prefetch_depth_);
+	std::unique_ptr<IGpuVideoTexture> texture;
+#else
+	std::unique_ptr<IGpuVideoTexture> texture;
+	if (job->mode == GPU_VIDEO_ON_GPU_MEMORY)
+	{
+		// Frames are uploaded a budget per cook from uploadGPU(); resident ones play right away.
+		std::shared_ptr<IGpuVideoReader> reader = job->reader;
+		std::shared_ptr<GpuVideoOnGpuMemoryStorage> storage = GpuVideoClipRegistry::acquire<GpuVideoOnGpuMemoryStorage>(job->file, "gpu", [&reader]() {
+			return std::make_shared<GpuVideoOnGpuMemoryStorage>(reader, GL_LINEAR, GL_CLAMP_TO_EDGE, true);
+		});
+		texture = std::make_unique<GpuVideoOnGpuMemoryTexture>(storage);
+	}
+	else
+	{
+		texture = std::make_unique<GpuVideoStreamingTexture>(job->reader, GL_LINEAR, GL_CLAMP_TO_EDGE, prefetch_depth_, 3, zero_copy_);
+	}
+#endif
+
+	reader_ = job->reader;
+	file_reader_ = job->fileReader;
+	cache_ = cache;
+	video_texture_ = std::move(texture);
+	if (video_texture_)
+	{
+		video_texture_->setUploadHook([this](const GpuVideoUploadTiming& timing) {
+			upload_timer_.addMilliseconds(timing.waitMs + timing.copyMs + timing.submitMs);
+		});
+	}
+	io_window_ = GpuVideoStageTimer::Window();
+	decode_window_ = GpuVideoStageTimer::Window();
+
 	width_ = reader_->getWidth();
 	height_ = reader_->getHeight();
 	frame_count_ = reader_->getFrameCount();
 	fps_ = reader_->getFramePerSecond();
-
-	//std::cout << "width : " << width_ << std::endl;
-	//std::cout << "header : " << height_ << std::endl;
-	//std::cout << "frame count : " << reader_->getFrameCount() << std::endl;
-	//std::cout << "fps : " << reader_->getFramePerSecond() << std::endl;
-	//std::cout << "==================" << std::endl;
+	frame_ = 0.f;
+	clock_.reset(frame_count_, fps_, clock_seconds_);
 
 	isLoaded_ = true;
+	load_state_ = LOAD_UPLOADING;
+	load_error_.clear();
+	load_started_ = job->started;
+#ifdef EX_GPU_VIDEO_CPU_OUTPUT
+	load_state_ = LOAD_READY;
+	load_elapsed_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - load_started_).count();
+#else
+	updateUpload();
+#endif
+}
+
+// Playable from the swap on; READY once the texture has the whole clip.
+void ExGpuVideoTOP::updateUpload()
+{
+	if (load_state_ != LOAD_UPLOADING || !video_texture_ || video_texture_->getUploadProgress() < 1.f)
+	{
+		return;
+	}
+	load_state_ = LOAD_READY;
+	load_elapsed_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - load_started_).count();
 }
 
 void ExGpuVideoTOP::unload() 
 {
 	video_texture_ = std::unique_ptr<IGpuVideoTexture>();
+	cpu_prefetcher_.reset();
+	block_decoder_.reset();
+	reader_.reset();
+	file_reader_.reset();
+	cache_.reset();
+	io_window_ = GpuVideoStageTimer::Window();
+	decode_window_ = GpuVideoStageTimer::Window();
+	upload_window_ = GpuVideoStageTimer::Window();
 	width_ = 0;
 	height_ = 0;
 	frame_count_ = 0;
 	fps_ = 0;
 	frame_ = 0;
 	isLoaded_ = false;
+	if (!load_job_)
+	{
+		load_state_ = LOAD_IDLE;
+	}
+}
+
+LoadState ExGpuVideoTOP::loadState() const
+{
+	return load_job_ ? (LoadState)load_job_->state.load() : load_state_;
+}
+
+float ExGpuVideoTOP::loadProgress() const
+{
+	if (!load_job_)
+	{
+		if (load_state_ == LOAD_UPLOADING && video_texture_)
+		{
+			return video_texture_->getUploadProgress();
+		}
+		return load_state_ == LOAD_READY ? 1.f : 0.f;
+	}
+	uint32_t total = load_job_->totalFrames;
+	return total == 0 ? 0.f : (float)load_job_->decodedFrames / (float)total;
+}
+
+double ExGpuVideoTOP::loadElapsed() const
+{
+	if (!load_job_)
+	{
+		if (load_state_ == LOAD_UPLOADING)
+		{
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - load_started_).count();
+		}
+		return load_elapsed_;
+	}
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - load_job_->started).count();
+}
+
+// Once per cook: turns the running stage totals into this cook's means.
+void ExGpuVideoTOP::updateStats()
+{
+	const GpuVideoReadTimers* timers = reader_ ? reader_->getTimers() : nullptr;
+	if (timers)
+	{
+		io_window_.update(timers->io);
+		decode_window_.update(timers->decode);
+	}
+	upload_window_.update(upload_timer_);
+}
+
+// Whichever read-ahead feeds this node: the CPU output's or the streaming texture's.
+const GpuVideoPrefetcher* ExGpuVideoTOP::activePrefetcher() const
+{
+	if (cpu_prefetcher_)
+	{
+		return cpu_prefetcher_.get();
+	}
+	return video_texture_ ? video_texture_->getPrefetcher() : nullptr;
 }
 
 
 void ExGpuVideoTOP::setupGL()
 {
 	shader_err = shader_prg.build(vertexShader, fragmentShader);
+	if (shader_err == nullptr)
+	{
+		shader_err = shader_array_prg.build(vertexShader, fragmentShaderArray);
+	}
 
 	// If an error occurred creating myProgram, we can't proceed
 	if (shader_err == nullptr)
@@ -1,5 +1,8 @@
 #include <iostream>
 #include <thread>
+#include <atomic>
+#include <chrono>
+#include <string>
 
 #include "TOP_CPlusPlusBase.h"
 #include "GL/Program.h"
@@ -8,10 +11,21 @@
 #include "ExtremeGpuVideo/GpuVideo.h"
 #include "ExtremeGpuVideo/GpuVideoIO.h"
 #include "ExtremeGpuVideo/GpuVideoReader.h"
+#include "ExtremeGpuVideo/GpuVideoReaderMapped.h"
 #include "ExtremeGpuVideo/GpuVideoReaderDecompressed.h"
+#include "ExtremeGpuVideo/GpuVideoReaderCached.h"
+#include "ExtremeGpuVideo/GpuVideoClock.h"
+#include "ExtremeGpuVideo/GpuVideoClipRegistry.h"
 #include "ExtremeGpuVideo/GpuVideoTexture.h"
 #include "ExtremeGpuVideo/GpuVideoStreamingTexture.h"
 #include "ExtremeGpuVideo/GpuVideoOnGpuMemoryTexture.h"
+#include "ExtremeGpuVideo/GpuVideoPrefetcher.h"
+#include "ExtremeGpuVideo/GpuVideoBlockDecoder.h"
+#include "ExtremeGpuVideo/GpuVideoThreadPool.h"
+#include "ExtremeGpuVideo/GpuVideoStageTimer.h"
+
+// Define EX_GPU_VIDEO_CPU_OUTPUT to build a CPUMemWriteOnly TOP that decodes the
+// compressed frames in software instead of drawing them with OpenGL.
 
 
 class ExGpuVideoTOP : public TOP_CPlusPlusBase
@@ -41,20 +55,55 @@ public:
 											void* reserved1) override;
 
     virtual void		getErrorString(OP_String *error, void* reserved1) override;
+	virtual void		getWarningString(OP_String *warning, void* reserved1) override;
 
 	virtual void		setupParameters(OP_ParameterManager *manager, void* reserved1) override;
 	virtual void		pulsePressed(const char *name, void* reserved1) override;
 
 private:
+	// Handed from the cook thread to the background loader and back.
+	struct LoadJob
+	{
+		std::string							path;
+		GpuVideoFileIdentity				file;
+		Mode								mode;
+		int									decodeThreads;
+		GpuVideoVerify						verify;
+		bool								directIO;
+		int									coalesceFrames;
+
+		std::atomic<int>					state;
+		// Set by the cook thread when nobody will collect the result; the loader gives up at its next check.
+		std::atomic<bool>					cancelled;
+		std::atomic<uint32_t>				decodedFrames;
+		std::atomic<uint32_t>				totalFrames;
+		std::shared_ptr<IGpuVideoReader>	reader;
+		// The shared file reader under reader in the storage modes, null otherwise
+		std::shared_ptr<GpuVideoReader>		fileReader;
+		std::string							error;
+		std::chrono::steady_clock::time_point started;
+	};
+
     void                setupGL();
-	void				load();
+	void				requestLoad();
+	void				startLoad();
+	void				updateLoad();
+	void				updateUpload();
+	void				executeCPU(TOP_OutputFormatSpecs* outputFormat, float speed);
+	void				updateStats();
 	void				unload();
 
+	LoadState			loadState() const;
+	float				loadProgress() const;
+	double				loadElapsed() const;
+	const GpuVideoPrefetcher* activePrefetcher() const;
+
 	const OP_NodeInfo*	node_info;
 
 	int32_t				exec_count_;
 
     Program				shader_prg;
+    Program				shader_array_prg;
     const char*			shader_err;
 
 	GLuint				vao;
@@ -65,13 +114,44 @@ private:
 	int					frame_count_;
 	float				fps_;
 	float				frame_;
+	GpuVideoClock		clock_;
+	double				clock_seconds_;
+	bool				seek_requested_;
 	Mode				mode_;
 	const char*			filepath;
+	int					decode_threads_;
+	GpuVideoVerify		verify_;
+	int					prefetch_depth_;
+	int					coalesce_frames_;
+	bool				zero_copy_;
+	bool				direct_io_;
+	double				upload_budget_ms_;
+	double				upload_budget_mb_;
+	double				cache_mb_;
+
+	// Per-cook means of the stage timers for the Info CHOP
+	GpuVideoStageTimer	upload_timer_;
+	GpuVideoStageTimer::Window io_window_;
+	GpuVideoStageTimer::Window decode_window_;
+	GpuVideoStageTimer::Window upload_window_;
 
 	std::shared_ptr<IGpuVideoReader> reader_;
+	std::shared_ptr<GpuVideoReader> file_reader_;
+	std::shared_ptr<GpuVideoReaderCached> cache_;
 	std::unique_ptr<IGpuVideoTexture> video_texture_;
+	std::unique_ptr<GpuVideoPrefetcher> cpu_prefetcher_;
+	std::unique_ptr<GpuVideoBlockDecoder> block_decoder_;
 
 	std::unique_ptr<std::thread> thread_;
+	std::shared_ptr<LoadJob> load_job_;
+	bool				load_pending_;
+	bool				reload_requested_;
+	bool				unload_requested_;
+	LoadState			load_state_;
+	double				load_elapsed_;
+	std::chrono::steady_clock::time_point load_started_;
+	std::string			load_error_;
+	std::string			warning_;
 
 	std::string current;
 	std::string previous;
@@ -32,4 +32,55 @@ static const uint32_t kRawMemoryAt = 24;
 struct Lz4Block {
     uint64_t address = 0;
     uint64_t size = 0;
+};
+
+/*
+ v2, told apart from v1 by the magic (no v1 file is that wide):
+ 0: uint32_t magic "GPUV"
+ 4: uint32_t version (2)
+ 8: uint32_t header bytes (zero based address of the first lz4 block)
+ 12: uint32_t width
+ 16: uint32_t height
+ 20: uint32_t frame count
+ 24: float fps
+ 28: uint32_t fmt
+ 32: uint32_t frame bytes
+ 36: uint32_t chunk count
+ 40: uint64_t chunk table address
+ 48..header bytes: fields added later, readers skip what they do not know
+ header bytes: raw memory storage
+ then chunk payloads and the chunk table [GpuVideoChunk..<chunk count>]
+ Required chunks: GPU_VIDEO_CHUNK_INDEX, the Lz4Block array as in v1.
+
+ GPU_VIDEO_CHUNK_STRIPS (required when present): each lz4 block is a run of independently
+ compressed strips of whole block rows, top to bottom, the last one possibly shorter.
+ 0: uint32_t block rows per strip
+ 4: uint32_t strips per frame
+ 8: [uint32_t..<frame count * strips per frame] compressed size of each strip
+
+ GPU_VIDEO_CHUNK_CHECKSUMS (optional): [uint64_t..<frame count] XXH64 (seed 0) of each lz4 block
+ */
+
+static const uint32_t kGpuVideoMagic = 0x56555047; // "GPUV"
+static const uint32_t kGpuVideoVersion = 2;
+static const uint32_t kGpuVideoHeaderBytes = 48;
+
+#define GPU_VIDEO_FOURCC(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+enum GPU_VIDEO_CHUNK : uint32_t {
+    GPU_VIDEO_CHUNK_INDEX = GPU_VIDEO_FOURCC('I', 'N', 'D', 'X'),
+    GPU_VIDEO_CHUNK_STRIPS = GPU_VIDEO_FOURCC('S', 'T', 'R', 'P'),
+    GPU_VIDEO_CHUNK_CHECKSUMS = GPU_VIDEO_FOURCC('X', 'X', '6', '4')
+};
+
+enum GPU_VIDEO_CHUNK_FLAGS : uint32_t {
+    // Readers that do not know the chunk must refuse the file rather than skip it.
+    GPU_VIDEO_CHUNK_REQUIRED = 1
+};
+
+struct GpuVideoChunk {
+    uint32_t id = 0;
+    uint32_t flags = 0;
+    uint64_t address = 0;
+    uint64_t size = 0;
 };
\ No newline at end of file
@@ -0,0 +1,400 @@
+//
+//  GpuVideoBlockDecoder.cpp
+//
+//  DXT1 / DXT3 / DXT5 / BC7 frames back to RGBA8 pixels on the CPU.
+//
+
+#include "GpuVideoBlockDecoder.h"
+#include "GpuVideoBlockKernels.h"
+#include "GpuVideoThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    uint32_t expand565(uint16_t c) {
+        uint32_t r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        r = (r << 3) | (r >> 2);
+        g = (g << 2) | (g >> 4);
+        b = (b << 3) | (b >> 2);
+        return r | (g << 8) | (b << 16) | 0xff000000u;
+    }
+    uint32_t mix(uint32_t a, uint32_t b, uint32_t wa, uint32_t wb, uint32_t divisor) {
+        uint32_t v = 0;
+        for (int c = 0; c < 24; c += 8) {
+            v |= (((a >> c) & 0xff) * wa + ((b >> c) & 0xff) * wb) / divisor << c;
+        }
+        return v | 0xff000000u;
+    }
+
+    // BC7 mode table: subsets, partition / rotation / index selection bits, color / alpha bits,
+    // per endpoint / shared p-bits, primary / secondary index bits.
+    struct Bc7Mode {
+        int subsets;
+        int partitionBits;
+        int rotationBits;
+        int indexSelectionBits;
+        int colorBits;
+        int alphaBits;
+        int endpointPBits;
+        int sharedPBits;
+        int indexBits;
+        int indexBits2;
+    };
+    const Bc7Mode kBc7Modes[8] = {
+        { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+        { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+        { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+        { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+        { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+        { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+        { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+        { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+    };
+
+    // Subset of each pixel, 2 bits per pixel from the low end.
+    const uint32_t kBc7Partitions2[64] = {
+        0x50505050, 0x40404040, 0x54545454, 0x54505040, 0x50404000, 0x55545450, 0x55545040, 0x54504000,
+        0x50400000, 0x55555450, 0x55544000, 0x54400000, 0x55555440, 0x55550000, 0x55555500, 0x55000000,
+        0x55150100, 0x00004054, 0x15010000, 0x00405054, 0x00004050, 0x15050100, 0x05010000, 0x40505054,
+        0x00404050, 0x05010100, 0x14141414, 0x05141450, 0x01155440, 0x00555500, 0x15014054, 0x05414150,
+        0x44444444, 0x55005500, 0x11441144, 0x05055050, 0x05500550, 0x11114444, 0x41144114, 0x44111144,
+        0x15055054, 0x01055040, 0x05041050, 0x05455150, 0x14414114, 0x50050550, 0x41411414, 0x00141400,
+        0x00041504, 0x00105410, 0x10541000, 0x04150400, 0x50410514, 0x41051450, 0x05415014, 0x14054150,
+        0x41050514, 0x41505014, 0x40011554, 0x54150140, 0x50505500, 0x00555050, 0x15151010, 0x54540404,
+    };
+    const uint32_t kBc7Partitions3[64] = {
+        0xaa685050, 0x6a5a5040, 0x5a5a4200, 0x5450a0a8, 0xa5a50000, 0xa0a05050, 0x5555a0a0, 0x5a5a5050,
+        0xaa550000, 0xaa555500, 0xaaaa5500, 0x90909090, 0x94949494, 0xa4a4a4a4, 0xa9a59450, 0x2a0a4250,
+        0xa5945040, 0x0a425054, 0xa5a5a500, 0x55a0a0a0, 0xa8a85454, 0x6a6a4040, 0xa4a45000, 0x1a1a0500,
+        0x0050a4a4, 0xaaa59090, 0x14696914, 0x69691400, 0xa08585a0, 0xaa821414, 0x50a4a450, 0x6a5a0200,
+        0xa9a58000, 0x5090a0a8, 0xa8a09050, 0x24242424, 0x00aa5500, 0x24924924, 0x24499224, 0x50a50a50,
+        0x500aa550, 0xaaaa4444, 0x66660000, 0xa5a0a5a0, 0x50a050a0, 0x69286928, 0x44aaaa44, 0x66666600,
+        0xaa444444, 0x54a854a8, 0x95809580, 0x96969600, 0xa85454a8, 0x80959580, 0xaa141414, 0x96960000,
+        0xaaaa1414, 0xa05050a0, 0xa0a5a5a0, 0x96000000, 0x40804080, 0xa9a8a9a8, 0xaaaaaa44, 0x2a4a5254,
+    };
+    // Anchor pixel of subset 1 (two subsets), of subsets 1 and 2 (three subsets); subset 0 anchors at pixel 0.
+    const uint8_t kBc7Anchors2[64] = {
+        15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+        15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+        6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15,
+    };
+    const uint8_t kBc7Anchors3[2][64] = {
+        {
+            3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3,
+            3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+            8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15,
+            3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3,
+        },
+        {
+            15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8,
+            15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+            15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8,
+            15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8,
+        },
+    };
+
+    const uint8_t kBc7Weights2[4] = { 0, 21, 43, 64 };
+    const uint8_t kBc7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+    const uint8_t kBc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    const uint8_t* bc7Weights(int bits) {
+        return bits == 2 ? kBc7Weights2 : bits == 3 ? kBc7Weights3 : kBc7Weights4;
+    }
+
+    // LSB first reader over one 128 bit block.
+    class Bc7Bits {
+    public:
+        explicit Bc7Bits(const uint8_t* block) {
+            memcpy(&_lo, block, 8);
+            memcpy(&_hi, block + 8, 8);
+        }
+        uint32_t read(int count) {
+            if (count == 0) {
+                return 0;
+            }
+            uint64_t v;
+            if (64 <= _at) {
+                v = _hi >> (_at - 64);
+            }
+            else if (_at + count <= 64) {
+                v = _lo >> _at;
+            }
+            else {
+                v = (_lo >> _at) | (_hi << (64 - _at));
+            }
+            _at += count;
+            return static_cast<uint32_t>(v & ((1u << count) - 1));
+        }
+        void skip(int count) { _at += count; }
+    private:
+        uint64_t _lo = 0;
+        uint64_t _hi = 0;
+        int _at = 0;
+    };
+
+    // n bit value to 8 bits by replicating the high bits.
+    uint32_t unquantize(uint32_t v, int bits) {
+        v <<= 8 - bits;
+        return v | (v >> bits);
+    }
+}
+
+GpuVideoBlockDecoder::GpuVideoBlockDecoder(GPU_COMPRESS format, Isa isa)
+    : _format(format)
+    , _isa(std::min(isa, GpuVideoBlockEncoder::bestIsa())) {
+    if (format != GPU_COMPRESS_DXT1 && format != GPU_COMPRESS_DXT3 && format != GPU_COMPRESS_DXT5 && format != GPU_COMPRESS_BC7) {
+        throw std::runtime_error("unknown block format " + std::to_string(static_cast<int>(format)));
+    }
+    _kernels = &gpuVideoBlockKernels(_isa);
+}
+
+void GpuVideoBlockDecoder::decode(const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba, ptrdiff_t stride, uint32_t threads) const {
+    uint32_t rows = (height + 3) / 4;
+    size_t rowBytes = static_cast<size_t>((width + 3) / 4) * getBlockBytes();
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min(threads, rows);
+    if (threads <= 1) {
+        for (uint32_t by = 0; by < rows; ++by) {
+            decodeRow(blocks + by * rowBytes, width, height, by, rgba, stride);
+        }
+        return;
+    }
+
+    std::atomic<uint32_t> next(0);
+    auto work = [&]() {
+        for (uint32_t by = next++; by < rows; by = next++) {
+            decodeRow(blocks + by * rowBytes, width, height, by, rgba, stride);
+        }
+    };
+    GpuVideoThreadPool::shared().parallel(threads, work);
+}
+
+void GpuVideoBlockDecoder::decodeRow(const uint8_t* blocks, uint32_t width, uint32_t height, uint32_t by, uint8_t* rgba, ptrdiff_t stride) const {
+    uint32_t blockBytes = getBlockBytes();
+    uint32_t rows = std::min(4u, height - by * 4);
+    uint32_t pixels[16];
+    for (uint32_t bx = 0; bx * 4 < width; ++bx) {
+        decodeBlock(blocks + bx * blockBytes, reinterpret_cast<uint8_t*>(pixels));
+        size_t columns = std::min(4u, width - bx * 4);
+        for (uint32_t y = 0; y < rows; ++y) {
+            uint8_t* dst = rgba + static_cast<ptrdiff_t>(by * 4 + y) * stride + bx * 16;
+            memcpy(dst, pixels + y * 4, columns * 4);
+        }
+    }
+}
+
+void GpuVideoBlockDecoder::decodeBlock(const uint8_t* block, uint8_t* rgba) const {
+    uint32_t out[16];
+    switch (_format) {
+    case GPU_COMPRESS_DXT1:
+        decodeColor(block, true, out);
+        break;
+    case GPU_COMPRESS_DXT3:
+        decodeColor(block + 8, false, out);
+        decodeExplicitAlpha(block, out);
+        break;
+    case GPU_COMPRESS_DXT5:
+        decodeColor(block + 8, false, out);
+        decodeInterpolatedAlpha(block, out);
+        break;
+    case GPU_COMPRESS_BC7:
+        decodeBc7(block, out);
+        break;
+    }
+    memcpy(rgba, out, sizeof(out));
+}
+
+// threeColor: DXT1 only; DXT3 / DXT5 color blocks always use four colors.
+void GpuVideoBlockDecoder::decodeColor(const uint8_t* block, bool threeColor, uint32_t out[16]) const {
+    uint16_t c0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+    uint16_t c1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+    uint32_t palette[16] = {};
+    palette[0] = expand565(c0);
+    palette[1] = expand565(c1);
+    if (c0 > c1 || !threeColor) {
+        palette[2] = mix(palette[0], palette[1], 2, 1, 3);
+        palette[3] = mix(palette[0], palette[1], 1, 2, 3);
+    }
+    else {
+        palette[2] = mix(palette[0], palette[1], 1, 1, 2);
+        palette[3] = 0;     // transparent black
+    }
+    uint8_t indices[16];
+    for (int i = 0; i < 16; ++i) {
+        indices[i] = (block[4 + i / 4] >> ((i % 4) * 2)) & 3;
+    }
+    _kernels->expand(palette, 4, indices, 0, out);
+}
+
+void GpuVideoBlockDecoder::decodeExplicitAlpha(const uint8_t* block, uint32_t out[16]) const {
+    uint32_t palette[16];
+    for (uint32_t k = 0; k < 16; ++k) {
+        palette[k] = (k * 17) << 24;
+    }
+    uint8_t indices[16];
+    for (int i = 0; i < 16; ++i) {
+        indices[i] = (block[i / 2] >> ((i % 2) * 4)) & 15;
+    }
+    _kernels->expand(palette, 16, indices, 0x00ffffffu, out);
+}
+
+void GpuVideoBlockDecoder::decodeInterpolatedAlpha(const uint8_t* block, uint32_t out[16]) const {
+    uint32_t a0 = block[0], a1 = block[1];
+    uint32_t alpha[8] = { a0, a1 };
+    for (uint32_t k = 2; k < 8; ++k) {
+        if (a0 > a1) {
+            alpha[k] = ((8 - k) * a0 + (k - 1) * a1) / 7;
+        }
+        else {
+            alpha[k] = k < 6 ? ((6 - k) * a0 + (k - 1) * a1) / 5 : (k == 6 ? 0 : 255);
+        }
+    }
+    uint32_t palette[16] = {};
+    for (int k = 0; k < 8; ++k) {
+        palette[k] = alpha[k] << 24;
+    }
+    uint64_t bits = 0;
+    for (int i = 0; i < 6; ++i) {
+        bits |= static_cast<uint64_t>(block[2 + i]) << (i * 8);
+    }
+    uint8_t indices[16];
+    for (int i = 0; i < 16; ++i) {
+        indices[i] = static_cast<uint8_t>((bits >> (i * 3)) & 7);
+    }
+    _kernels->expand(palette, 8, indices, 0x00ffffffu, out);
+}
+
+void GpuVideoBlockDecoder::decodeBc7(const uint8_t* block, uint32_t out[16]) const {
+    int mode = 0;
+    while (mode < 8 && (block[0] & (1 << mode)) == 0) {
+        ++mode;
+    }
+    if (mode == 8) {
+        // Reserved mode: transparent black.
+        memset(out, 0, 16 * sizeof(uint32_t));
+        return;
+    }
+    const Bc7Mode& m = kBc7Modes[mode];
+
+    Bc7Bits bits(block);
+    bits.skip(mode + 1);
+    uint32_t partition = bits.read(m.partitionBits);
+    uint32_t rotation = bits.read(m.rotationBits);
+    uint32_t indexSelection = bits.read(m.indexSelectionBits);
+
+    int endpoints = m.subsets * 2;
+    uint32_t e[6][4];
+    for (int c = 0; c < 3; ++c) {
+        for (int i = 0; i < endpoints; ++i) {
+            e[i][c] = bits.read(m.colorBits);
+        }
+    }
+    for (int i = 0; i < endpoints; ++i) {
+        e[i][3] = bits.read(m.alphaBits);
+    }
+    int pBits = m.endpointPBits | m.sharedPBits;
+    if (pBits) {
+        uint32_t p[6];
+        for (int i = 0; i < endpoints; ++i) {
+            p[i] = m.endpointPBits ? bits.read(1) : 0;
+        }
+        if (m.sharedPBits) {
+            for (int s = 0; s < m.subsets; ++s) {
+                p[s * 2] = p[s * 2 + 1] = bits.read(1);
+            }
+        }
+        for (int i = 0; i < endpoints; ++i) {
+            for (int c = 0; c < 4; ++c) {
+                e[i][c] = (e[i][c] << 1) | p[i];
+            }
+        }
+    }
+    uint32_t words[6];
+    for (int i = 0; i < endpoints; ++i) {
+        uint32_t w = 0;
+        for (int c = 0; c < 3; ++c) {
+            w |= unquantize(e[i][c], m.colorBits + pBits) << (c * 8);
+        }
+        w |= (m.alphaBits ? unquantize(e[i][3], m.alphaBits + pBits) : 255u) << 24;
+        words[i] = w;
+    }
+
+    uint8_t subset[16] = {};
+    bool anchor[16] = {};
+    anchor[0] = true;
+    if (m.subsets == 2) {
+        for (int i = 0; i < 16; ++i) {
+            subset[i] = (kBc7Partitions2[partition] >> (i * 2)) & 3;
+        }
+        anchor[kBc7Anchors2[partition]] = true;
+    }
+    else if (m.subsets == 3) {
+        for (int i = 0; i < 16; ++i) {
+            subset[i] = (kBc7Partitions3[partition] >> (i * 2)) & 3;
+        }
+        anchor[kBc7Anchors3[0][partition]] = true;
+        anchor[kBc7Anchors3[1][partition]] = true;
+    }
+
+    // The anchor pixels store one bit less: their top bit is implied zero.
+    uint8_t indices[16];
+    uint8_t indices2[16];
+    for (int i = 0; i < 16; ++i) {
+        indices[i] = static_cast<uint8_t>(bits.read(m.indexBits - (anchor[i] ? 1 : 0)));
+    }
+    if (m.indexBits2) {
+        for (int i = 0; i < 16; ++i) {
+            indices2[i] = static_cast<uint8_t>(bits.read(m.indexBits2 - (i == 0 ? 1 : 0)));
+        }
+    }
+
+    uint32_t palette[3][16];
+    if (!m.indexBits2) {
+        int entries = 1 << m.indexBits;
+        for (int s = 0; s < m.subsets; ++s) {
+            _kernels->interpolate(words[s * 2], words[s * 2 + 1], bc7Weights(m.indexBits), entries, palette[s]);
+        }
+        if (m.subsets == 1) {
+            _kernels->expand(palette[0], entries, indices, 0, out);
+        }
+        else {
+            for (int i = 0; i < 16; ++i) {
+                out[i] = palette[subset[i]][indices[i]];
+            }
+        }
+    }
+    else {
+        // Modes 4 and 5: separate color and alpha indices; the index selection bit swaps them.
+        const uint8_t* colorIndices = indexSelection ? indices2 : indices;
+        const uint8_t* alphaIndices = indexSelection ? indices : indices2;
+        int colorBits = indexSelection ? m.indexBits2 : m.indexBits;
+        int alphaBits = indexSelection ? m.indexBits : m.indexBits2;
+        _kernels->interpolate(words[0], words[1], bc7Weights(colorBits), 1 << colorBits, palette[0]);
+        _kernels->interpolate(words[0], words[1], bc7Weights(alphaBits), 1 << alphaBits, palette[1]);
+        for (int k = 0; k < 16; ++k) {
+            palette[0][k] &= 0x00ffffffu;
+            palette[1][k] &= 0xff000000u;
+        }
+        _kernels->expand(palette[0], 1 << colorBits, colorIndices, 0, out);
+        _kernels->expand(palette[1], 1 << alphaBits, alphaIndices, 0x00ffffffu, out);
+    }
+
+    if (rotation) {
+        // 1, 2, 3: alpha swapped with red, green, blue.
+        int shift = static_cast<int>(rotation - 1) * 8;
+        for (int i = 0; i < 16; ++i) {
+            uint32_t a = out[i] >> 24;
+            uint32_t c = (out[i] >> shift) & 0xff;
+            out[i] = (out[i] & ~(0xffu << shift) & 0x00ffffffu) | (a << shift) | (c << 24);
+        }
+    }
+}
@@ -0,0 +1,53 @@
+//
+//  GpuVideoBlockDecoder.h
+//
+//  DXT1 / DXT3 / DXT5 / BC7 frames back to RGBA8 pixels on the CPU.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "GpuVideo.h"
+#include "GpuVideoBlockEncoder.h"
+
+struct GpuVideoBlockKernels;
+
+/**
+ * Software decoder for every GPU_COMPRESS format, for CPU output and for
+ * checking what the GPU should show. Palette expansion and the BC7
+ * interpolation run on SSE2 or AVX2 when the CPU has them; every instruction
+ * set gives bit identical output to the scalar reference.
+ * DXT1 / DXT3 / DXT5 interpolate with (2 a + b) / 3 and ((8 - k) a + (k - 1) b) / 7
+ * like GpuVideoBlockEncoder assumes, which GPUs are allowed to round within a
+ * step or two of; BC7 follows the specification exactly.
+ */
+class GpuVideoBlockDecoder {
+public:
+    typedef GpuVideoBlockEncoder::Isa Isa;
+
+    // isa is lowered to what the CPU supports.
+    explicit GpuVideoBlockDecoder(GPU_COMPRESS format, Isa isa = GpuVideoBlockEncoder::bestIsa());
+
+    GPU_COMPRESS getFormat() const { return _format; }
+    Isa getIsa() const { return _isa; }
+    uint32_t getBlockBytes() const { return _format == GPU_COMPRESS_DXT1 ? 8 : 16; }
+
+    // blocks: one frame of width x height. rgba: first output row, stride bytes apart;
+    // a negative stride writes bottom up (TouchDesigner's CPU memory layout).
+    // Rows of blocks are spread over threads (0 = one per hardware thread).
+    void decode(const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba, ptrdiff_t stride, uint32_t threads = 0) const;
+    // 16 RGBA8 pixels, row major
+    void decodeBlock(const uint8_t* block, uint8_t* rgba) const;
+private:
+    void decodeColor(const uint8_t* block, bool threeColor, uint32_t out[16]) const;
+    void decodeExplicitAlpha(const uint8_t* block, uint32_t out[16]) const;
+    void decodeInterpolatedAlpha(const uint8_t* block, uint32_t out[16]) const;
+    void decodeBc7(const uint8_t* block, uint32_t out[16]) const;
+    void decodeRow(const uint8_t* blocks, uint32_t width, uint32_t height, uint32_t by, uint8_t* rgba, ptrdiff_t stride) const;
+
+    GPU_COMPRESS _format;
+    Isa _isa;
+    const GpuVideoBlockKernels* _kernels;
+};
@@ -0,0 +1,345 @@
+//
+//  GpuVideoBlockEncoder.cpp
+//
+//  RGBA8 to BC1 (DXT1) / BC3 (DXT5) block compression.
+//
+
+#include "GpuVideoBlockEncoder.h"
+#include "GpuVideoBlockKernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(_MSC_VER) && defined(GPU_VIDEO_BLOCK_KERNELS_X86)
+#include <intrin.h>
+#endif
+
+namespace {
+    struct Rgb565 {
+        uint16_t packed = 0;
+        int rgb[3] = {};    // expanded back to 8 bits, as the GPU sees it
+    };
+
+    Rgb565 quantize(const int rgb[3]) {
+        int r = (std::min(std::max(rgb[0], 0), 255) * 31 + 127) / 255;
+        int g = (std::min(std::max(rgb[1], 0), 255) * 63 + 127) / 255;
+        int b = (std::min(std::max(rgb[2], 0), 255) * 31 + 127) / 255;
+        Rgb565 c;
+        c.packed = static_cast<uint16_t>((r << 11) | (g << 5) | b);
+        c.rgb[0] = (r << 3) | (r >> 2);
+        c.rgb[1] = (g << 2) | (g >> 4);
+        c.rgb[2] = (b << 3) | (b >> 2);
+        return c;
+    }
+
+    // BC1 index of the four points from color0 to color1
+    const uint8_t kColorIndexOfLevel[4] = { 0, 2, 3, 1 };
+    // BC3 index of the eight points from alpha1 (min) to alpha0 (max)
+    const uint8_t kAlphaIndexOfLevel[8] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+
+    struct ColorBlock {
+        Rgb565 c0, c1;
+        uint8_t indices[16] = {};
+        int error = 0x7fffffff;
+    };
+
+    bool hasAvx2() {
+#if defined(GPU_VIDEO_BLOCK_KERNELS_X86)
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2") != 0;
+#endif
+#else
+        return false;
+#endif
+    }
+}
+
+GpuVideoBlockEncoder::Isa GpuVideoBlockEncoder::bestIsa() {
+#if defined(GPU_VIDEO_BLOCK_KERNELS_X86)
+    static const Isa isa = hasAvx2() ? ISA_AVX2 : ISA_SSE2;
+    return isa;
+#else
+    return ISA_SCALAR;
+#endif
+}
+const char* GpuVideoBlockEncoder::isaName(Isa isa) {
+    switch (isa) {
+    case ISA_SCALAR:
+        return "scalar";
+    case ISA_SSE2:
+        return "sse2";
+    case ISA_AVX2:
+        return "avx2";
+    }
+    return "";
+}
+
+GpuVideoBlockEncoder::GpuVideoBlockEncoder(GPU_COMPRESS format, Quality quality, Isa isa)
+    : _format(format)
+    , _quality(quality)
+    , _isa(std::min(isa, bestIsa())) {
+    if (format != GPU_COMPRESS_DXT1 && format != GPU_COMPRESS_DXT5) {
+        throw std::runtime_error("block encoder supports DXT1 and DXT5 only");
+    }
+    _kernels = &gpuVideoBlockKernels(_isa);
+}
+
+uint32_t GpuVideoBlockEncoder::getFrameBytes(uint32_t width, uint32_t height) const {
+    return ((width + 3) / 4) * ((height + 3) / 4) * getBlockBytes();
+}
+
+void GpuVideoBlockEncoder::encode(const uint8_t* rgba, uint32_t width, uint32_t height, size_t stride, uint8_t* dst, uint32_t threads) const {
+    uint32_t rows = (height + 3) / 4;
+    size_t rowBytes = static_cast<size_t>((width + 3) / 4) * getBlockBytes();
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min(threads, rows);
+    if (threads <= 1) {
+        for (uint32_t by = 0; by < rows; ++by) {
+            encodeRow(rgba, width, height, stride, by, dst + by * rowBytes);
+        }
+        return;
+    }
+
+    std::atomic<uint32_t> next(0);
+    auto work = [&]() {
+        for (uint32_t by = next++; by < rows; by = next++) {
+            encodeRow(rgba, width, height, stride, by, dst + by * rowBytes);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (uint32_t t = 1; t < threads; ++t) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread& w : workers) {
+        w.join();
+    }
+}
+
+void GpuVideoBlockEncoder::encodeRow(const uint8_t* rgba, uint32_t width, uint32_t height, size_t stride, uint32_t by, uint8_t* dst) const {
+    uint8_t block[64];
+    uint32_t blockBytes = getBlockBytes();
+    for (uint32_t bx = 0; bx * 4 < width; ++bx) {
+        for (uint32_t y = 0; y < 4; ++y) {
+            uint32_t sy = std::min(by * 4 + y, height - 1);
+            const uint8_t* row = rgba + sy * stride;
+            if (bx * 4 + 4 <= width) {
+                memcpy(block + y * 16, row + bx * 16, 16);
+                continue;
+            }
+            for (uint32_t x = 0; x < 4; ++x) {
+                uint32_t sx = std::min(bx * 4 + x, width - 1);
+                memcpy(block + y * 16 + x * 4, row + sx * 4, 4);
+            }
+        }
+        encodeBlock(block, dst + bx * blockBytes);
+    }
+}
+
+void GpuVideoBlockEncoder::encodeBlock(const uint8_t* block, uint8_t* dst) const {
+    GpuVideoBlockStats stats;
+    _kernels->stats(block, &stats);
+    if (_format == GPU_COMPRESS_DXT5) {
+        encodeAlpha(block, stats.min[3], stats.max[3], dst);
+        dst += 8;
+    }
+    encodeColor(block, stats, dst);
+}
+
+void GpuVideoBlockEncoder::encodeAlpha(const uint8_t* block, int amin, int amax, uint8_t* dst) const {
+    // alpha0 > alpha1 selects the eight alpha mode.
+    dst[0] = static_cast<uint8_t>(amax);
+    dst[1] = static_cast<uint8_t>(amin);
+    uint64_t bits = 0;
+    if (amin < amax) {
+        uint8_t levels[16];
+        _kernels->alphaLevels(block, amin, amax, levels);
+        for (int i = 0; i < 16; ++i) {
+            bits |= static_cast<uint64_t>(kAlphaIndexOfLevel[levels[i]]) << (i * 3);
+        }
+    }
+    for (int i = 0; i < 6; ++i) {
+        dst[2 + i] = static_cast<uint8_t>(bits >> (i * 8));
+    }
+}
+
+void GpuVideoBlockEncoder::encodeColor(const uint8_t* block, const GpuVideoBlockStats& stats, uint8_t* dst) const {
+    const int* mn = stats.min;
+    const int* mx = stats.max;
+
+    // Covariance (times 256) from the integer sums.
+    int64_t cov[3][3];
+    const int64_t products[6] = { stats.rr, stats.gg, stats.bb, stats.rg, stats.rb, stats.gb };
+    const int pairs[6][2] = { { 0, 0 }, { 1, 1 }, { 2, 2 }, { 0, 1 }, { 0, 2 }, { 1, 2 } };
+    for (int k = 0; k < 6; ++k) {
+        int a = pairs[k][0], b = pairs[k][1];
+        cov[a][b] = cov[b][a] = 16 * products[k] - static_cast<int64_t>(stats.sum[a]) * stats.sum[b];
+    }
+
+    // Box diagonal oriented by the sign of the covariance with the widest channel.
+    int widest = 0;
+    for (int c = 1; c < 3; ++c) {
+        if (mx[widest] - mn[widest] < mx[c] - mn[c]) {
+            widest = c;
+        }
+    }
+    int lo[3], hi[3];
+    for (int c = 0; c < 3; ++c) {
+        bool flip = cov[widest][c] < 0;
+        lo[c] = flip ? mx[c] : mn[c];
+        hi[c] = flip ? mn[c] : mx[c];
+    }
+
+    if (_quality != QUALITY_FAST && (lo[0] != hi[0] || lo[1] != hi[1] || lo[2] != hi[2])) {
+        // Principal axis by power iteration, starting from the box diagonal.
+        double axis[3] = { double(hi[0] - lo[0]), double(hi[1] - lo[1]), double(hi[2] - lo[2]) };
+        for (int iteration = 0; iteration < 4; ++iteration) {
+            double next[3];
+            for (int r = 0; r < 3; ++r) {
+                next[r] = cov[r][0] * axis[0] + cov[r][1] * axis[1] + cov[r][2] * axis[2];
+            }
+            double scale = std::max(std::fabs(next[0]), std::max(std::fabs(next[1]), std::fabs(next[2])));
+            if (scale <= 0.0) {
+                break;
+            }
+            for (int r = 0; r < 3; ++r) {
+                axis[r] = next[r] / scale;
+            }
+        }
+        double scale = std::max(std::fabs(axis[0]), std::max(std::fabs(axis[1]), std::fabs(axis[2])));
+        int dir[3];
+        for (int c = 0; c < 3; ++c) {
+            dir[c] = static_cast<int>(std::floor(axis[c] / scale * 1023.0 + 0.5));
+        }
+
+        // Endpoints are the extent of the pixels along the axis through the mean.
+        static const int kOrigin[3] = { 0, 0, 0 };
+        int32_t t[16];
+        _kernels->dots(block, kOrigin, dir, t);
+        int32_t tmin = t[0], tmax = t[0];
+        for (int i = 1; i < 16; ++i) {
+            tmin = std::min(tmin, t[i]);
+            tmax = std::max(tmax, t[i]);
+        }
+        double len2 = double(dir[0]) * dir[0] + double(dir[1]) * dir[1] + double(dir[2]) * dir[2];
+        double tmean = (double(stats.sum[0]) * dir[0] + double(stats.sum[1]) * dir[1] + double(stats.sum[2]) * dir[2]) / 16.0;
+        for (int c = 0; c < 3; ++c) {
+            double mean = stats.sum[c] / 16.0;
+            lo[c] = static_cast<int>(std::floor(mean + (tmin - tmean) * dir[c] / len2 + 0.5));
+            hi[c] = static_cast<int>(std::floor(mean + (tmax - tmean) * dir[c] / len2 + 0.5));
+        }
+    }
+
+    // Pull the ends in a little: extremes are rarely worth an exact palette entry.
+    for (int c = 0; c < 3; ++c) {
+        int inset = (hi[c] - lo[c]) / 16;
+        lo[c] += inset;
+        hi[c] -= inset;
+    }
+
+    auto solve = [&](const int a[3], const int b[3]) {
+        ColorBlock result;
+        Rgb565 qa = quantize(a);
+        Rgb565 qb = quantize(b);
+        // color0 > color1 selects the four color mode.
+        result.c0 = qa.packed >= qb.packed ? qa : qb;
+        result.c1 = qa.packed >= qb.packed ? qb : qa;
+        if (result.c0.packed == result.c1.packed) {
+            // Single color: every index 0.
+            int palette[4][3];
+            for (int k = 0; k < 4; ++k) {
+                memcpy(palette[k], result.c0.rgb, sizeof(palette[k]));
+            }
+            result.error = _kernels->nearestColors(block, palette, result.indices);
+            return result;
+        }
+        if (_quality == QUALITY_HIGH) {
+            int palette[4][3];
+            for (int c = 0; c < 3; ++c) {
+                palette[0][c] = result.c0.rgb[c];
+                palette[1][c] = result.c1.rgb[c];
+                palette[2][c] = (2 * result.c0.rgb[c] + result.c1.rgb[c]) / 3;
+                palette[3][c] = (result.c0.rgb[c] + 2 * result.c1.rgb[c]) / 3;
+            }
+            result.error = _kernels->nearestColors(block, palette, result.indices);
+        }
+        else {
+            uint8_t levels[16];
+            _kernels->colorLevels(block, result.c0.rgb, result.c1.rgb, levels);
+            for (int i = 0; i < 16; ++i) {
+                result.indices[i] = kColorIndexOfLevel[levels[i]];
+            }
+        }
+        return result;
+    };
+
+    ColorBlock best = solve(hi, lo);
+
+    // Least squares endpoints for the chosen indices.
+    int refinements = _quality == QUALITY_HIGH ? 2 : _quality == QUALITY_NORMAL ? 1 : 0;
+    for (int iteration = 0; iteration < refinements; ++iteration) {
+        static const float kWeight[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+        float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+        float at[3] = {}, bt[3] = {};
+        for (int i = 0; i < 16; ++i) {
+            float w = kWeight[best.indices[i]];
+            float v = 1.0f - w;
+            aa += w * w;
+            bb += v * v;
+            ab += w * v;
+            for (int c = 0; c < 3; ++c) {
+                at[c] += w * block[i * 4 + c];
+                bt[c] += v * block[i * 4 + c];
+            }
+        }
+        float det = aa * bb - ab * ab;
+        if (std::fabs(det) < 1.0e-6f) {
+            break;
+        }
+        int a[3], b[3];
+        bool inRange = true;
+        for (int c = 0; c < 3; ++c) {
+            a[c] = static_cast<int>(std::floor((at[c] * bb - bt[c] * ab) / det + 0.5f));
+            b[c] = static_cast<int>(std::floor((bt[c] * aa - at[c] * ab) / det + 0.5f));
+            inRange = inRange && 0 <= std::min(a[c], b[c]) && std::max(a[c], b[c]) <= 255;
+        }
+        if (!inRange) {
+            // Clamping would no longer fit the pixels; happens when only the middle indices are used.
+            break;
+        }
+        ColorBlock refined = solve(a, b);
+        if (_quality == QUALITY_HIGH && best.error <= refined.error) {
+            break;
+        }
+        best = refined;
+    }
+
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; ++i) {
+        bits |= static_cast<uint32_t>(best.indices[i]) << (i * 2);
+    }
+    dst[0] = static_cast<uint8_t>(best.c0.packed);
+    dst[1] = static_cast<uint8_t>(best.c0.packed >> 8);
+    dst[2] = static_cast<uint8_t>(best.c1.packed);
+    dst[3] = static_cast<uint8_t>(best.c1.packed >> 8);
+    for (int i = 0; i < 4; ++i) {
+        dst[4 + i] = static_cast<uint8_t>(bits >> (i * 8));
+    }
+}
@@ -0,0 +1,65 @@
+//
+//  GpuVideoBlockEncoder.h
+//
+//  RGBA8 to BC1 (DXT1) / BC3 (DXT5) block compression.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "GpuVideo.h"
+
+struct GpuVideoBlockKernels;
+struct GpuVideoBlockStats;
+
+/**
+ * Compresses images into GPU_COMPRESS_DXT1 or GPU_COMPRESS_DXT5 frames.
+ * The per block inner loops run on SSE2 or AVX2 when the CPU has them; every
+ * instruction set gives bit identical output to the scalar reference.
+ * DXT1 ignores alpha (opaque four color blocks only).
+ */
+class GpuVideoBlockEncoder {
+public:
+    enum Quality {
+        // Bounding box endpoints, projected indices
+        QUALITY_FAST,
+        // Principal axis endpoints, one least squares refinement
+        QUALITY_NORMAL,
+        // Two refinements, nearest color indices, keeps the lowest error candidate
+        QUALITY_HIGH
+    };
+    enum Isa {
+        ISA_SCALAR,
+        ISA_SSE2,
+        ISA_AVX2
+    };
+
+    // isa is lowered to what the CPU supports.
+    GpuVideoBlockEncoder(GPU_COMPRESS format, Quality quality = QUALITY_NORMAL, Isa isa = bestIsa());
+
+    static Isa bestIsa();
+    static const char* isaName(Isa isa);
+
+    GPU_COMPRESS getFormat() const { return _format; }
+    Quality getQuality() const { return _quality; }
+    Isa getIsa() const { return _isa; }
+    uint32_t getBlockBytes() const { return _format == GPU_COMPRESS_DXT1 ? 8 : 16; }
+    uint32_t getFrameBytes(uint32_t width, uint32_t height) const;
+
+    // rgba: width x height pixels, stride bytes per row. Edge blocks repeat the last row / column.
+    // Rows of blocks are spread over threads (0 = one per hardware thread).
+    void encode(const uint8_t* rgba, uint32_t width, uint32_t height, size_t stride, uint8_t* dst, uint32_t threads = 0) const;
+    // block: 16 RGBA8 pixels, row major
+    void encodeBlock(const uint8_t* block, uint8_t* dst) const;
+private:
+    void encodeColor(const uint8_t* block, const GpuVideoBlockStats& stats, uint8_t* dst) const;
+    void encodeAlpha(const uint8_t* block, int amin, int amax, uint8_t* dst) const;
+    void encodeRow(const uint8_t* rgba, uint32_t width, uint32_t height, size_t stride, uint32_t by, uint8_t* dst) const;
+
+    GPU_COMPRESS _format;
+    Quality _quality;
+    Isa _isa;
+    const GpuVideoBlockKernels* _kernels;
+};
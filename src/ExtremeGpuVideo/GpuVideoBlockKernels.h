@@ -0,0 +1,51 @@
+//
+//  GpuVideoBlockKernels.h
+//
+//  Per 4x4 block inner loops of GpuVideoBlockEncoder and GpuVideoBlockDecoder,
+//  one table per instruction set. Internal to the two.
+//
+
+#pragma once
+
+#include <cstdint>
+
+/*
+ Every kernel works on one block of 16 RGBA8 pixels (64 bytes, row major) and
+ only does integer math, so the SSE2 and AVX2 tables produce exactly what the
+ scalar reference does.
+ */
+
+struct GpuVideoBlockStats {
+    int min[4];
+    int max[4];
+    int sum[4];
+    // Sums of channel products over the 16 pixels, for the covariance
+    int rr, gg, bb, rg, rb, gb;
+};
+
+struct GpuVideoBlockKernels {
+    void (*stats)(const uint8_t* rgba, GpuVideoBlockStats* out);
+    // out[i] = dot(rgb[i] - base, dir), |dir| components <= 1023
+    void (*dots)(const uint8_t* rgba, const int base[3], const int dir[3], int32_t out[16]);
+    // Nearest of the 4 evenly spaced points from c0 (level 0) to c1 (level 3), by projection
+    void (*colorLevels)(const uint8_t* rgba, const int c0[3], const int c1[3], uint8_t levels[16]);
+    // Nearest palette entry by squared RGB distance; returns the summed error
+    int (*nearestColors)(const uint8_t* rgba, const int palette[4][3], uint8_t indices[16]);
+    // Nearest of the 8 evenly spaced alphas from amin (level 0) to amax (level 7)
+    void (*alphaLevels)(const uint8_t* rgba, int amin, int amax, uint8_t levels[16]);
+
+    // Decoder: out[i] = (out[i] & keep) | palette[indices[i]]; palette holds 16 RGBA8 words, the first entries used
+    void (*expand)(const uint32_t* palette, int entries, const uint8_t indices[16], uint32_t keep, uint32_t out[16]);
+    // Decoder: out[k] = (e0 * (64 - weights[k]) + e1 * weights[k] + 32) >> 6 per channel,
+    // count a multiple of 4 up to 16 (the BC7 interpolation)
+    void (*interpolate)(uint32_t e0, uint32_t e1, const uint8_t* weights, int count, uint32_t* out);
+};
+
+// isa: GpuVideoBlockEncoder::Isa, already lowered to what the CPU supports
+const GpuVideoBlockKernels& gpuVideoBlockKernels(int isa);
+const GpuVideoBlockKernels& gpuVideoBlockKernelsScalar();
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define GPU_VIDEO_BLOCK_KERNELS_X86 1
+const GpuVideoBlockKernels& gpuVideoBlockKernelsSse2();
+const GpuVideoBlockKernels& gpuVideoBlockKernelsAvx2();
+#endif
@@ -0,0 +1,193 @@
+//
+//  GpuVideoBlockKernelsAvx2.cpp
+//
+//  AVX2 block kernels, eight pixels per register.
+//  Built with -mavx2 (gcc / clang); only called when the CPU reports AVX2.
+//
+
+#include "GpuVideoBlockKernels.h"
+
+#if defined(GPU_VIDEO_BLOCK_KERNELS_X86)
+
+#include <immintrin.h>
+
+namespace {
+    // Same lane layout as the SSE2 kernels: one pixel per 32 bit lane, pixel order.
+    inline __m256i channel(__m256i pixels, int shift) {
+        return _mm256_and_si256(_mm256_srli_epi32(pixels, shift), _mm256_set1_epi32(0xff));
+    }
+    inline __m256i pair(int lo, int hi) {
+        return _mm256_set1_epi32(static_cast<int>((static_cast<uint32_t>(hi) << 16) | (static_cast<uint32_t>(lo) & 0xffff)));
+    }
+    inline int horizontalSum(__m256i v) {
+        __m128i x = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+        x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(x);
+    }
+    // 16 int32 (2 registers, pixel order) to 16 bytes
+    inline void storeBytes(__m256i v0, __m256i v1, uint8_t out[16]) {
+        // packs works per 128 bit lane: pixels 0-3 8-11 | 4-7 12-15, put them back in order
+        __m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(v0, v1), _MM_SHUFFLE(3, 1, 2, 0));
+        __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), bytes);
+    }
+    inline __m256i load(const uint8_t* rgba, int i) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rgba) + i);
+    }
+    inline __m256i dot(__m256i pixels, __m256i rbDir, __m256i gDir, __m256i bias) {
+        __m256i rb = _mm256_and_si256(pixels, _mm256_set1_epi32(0x00ff00ff));
+        __m256i g = channel(pixels, 8);
+        return _mm256_sub_epi32(_mm256_add_epi32(_mm256_madd_epi16(rb, rbDir), _mm256_madd_epi16(g, gDir)), bias);
+    }
+
+    void stats(const uint8_t* rgba, GpuVideoBlockStats* out) {
+        __m256i p0 = load(rgba, 0), p1 = load(rgba, 1);
+        __m256i mn256 = _mm256_min_epu8(p0, p1);
+        __m256i mx256 = _mm256_max_epu8(p0, p1);
+        __m128i mn = _mm_min_epu8(_mm256_castsi256_si128(mn256), _mm256_extracti128_si256(mn256, 1));
+        __m128i mx = _mm_max_epu8(_mm256_castsi256_si128(mx256), _mm256_extracti128_si256(mx256, 1));
+        mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 8));
+        mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 4));
+        mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 8));
+        mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 4));
+        uint32_t mnBits = static_cast<uint32_t>(_mm_cvtsi128_si32(mn));
+        uint32_t mxBits = static_cast<uint32_t>(_mm_cvtsi128_si32(mx));
+
+        __m256i r0 = channel(p0, 0), g0 = channel(p0, 8), b0 = channel(p0, 16), a0 = _mm256_srli_epi32(p0, 24);
+        __m256i r1 = channel(p1, 0), g1 = channel(p1, 8), b1 = channel(p1, 16), a1 = _mm256_srli_epi32(p1, 24);
+        __m256i sum[4] = { _mm256_add_epi32(r0, r1), _mm256_add_epi32(g0, g1), _mm256_add_epi32(b0, b1), _mm256_add_epi32(a0, a1) };
+        for (int c = 0; c < 4; ++c) {
+            out->min[c] = (mnBits >> (c * 8)) & 0xff;
+            out->max[c] = (mxBits >> (c * 8)) & 0xff;
+            out->sum[c] = horizontalSum(sum[c]);
+        }
+        out->rr = horizontalSum(_mm256_add_epi32(_mm256_madd_epi16(r0, r0), _mm256_madd_epi16(r1, r1)));
+        out->gg = horizontalSum(_mm256_add_epi32(_mm256_madd_epi16(g0, g0), _mm256_madd_epi16(g1, g1)));
+        out->bb = horizontalSum(_mm256_add_epi32(_mm256_madd_epi16(b0, b0), _mm256_madd_epi16(b1, b1)));
+        out->rg = horizontalSum(_mm256_add_epi32(_mm256_madd_epi16(r0, g0), _mm256_madd_epi16(r1, g1)));
+        out->rb = horizontalSum(_mm256_add_epi32(_mm256_madd_epi16(r0, b0), _mm256_madd_epi16(r1, b1)));
+        out->gb = horizontalSum(_mm256_add_epi32(_mm256_madd_epi16(g0, b0), _mm256_madd_epi16(g1, b1)));
+    }
+
+    void dots(const uint8_t* rgba, const int base[3], const int dir[3], int32_t out[16]) {
+        __m256i rbDir = pair(dir[0], dir[2]);
+        __m256i gDir = pair(dir[1], 0);
+        __m256i bias = _mm256_set1_epi32(base[0] * dir[0] + base[1] * dir[1] + base[2] * dir[2]);
+        for (int i = 0; i < 2; ++i) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out) + i, dot(load(rgba, i), rbDir, gDir, bias));
+        }
+    }
+
+    void colorLevels(const uint8_t* rgba, const int c0[3], const int c1[3], uint8_t levels[16]) {
+        int d[3] = { c1[0] - c0[0], c1[1] - c0[1], c1[2] - c0[2] };
+        int len2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+        __m256i rbDir = pair(d[0], d[2]);
+        __m256i gDir = pair(d[1], 0);
+        __m256i bias = _mm256_set1_epi32(c0[0] * d[0] + c0[1] * d[1] + c0[2] * d[2]);
+        __m256i step1 = _mm256_set1_epi32(len2), step3 = _mm256_set1_epi32(3 * len2), step5 = _mm256_set1_epi32(5 * len2);
+        __m256i three = _mm256_set1_epi32(3);
+        __m256i v[2];
+        for (int i = 0; i < 2; ++i) {
+            __m256i t = dot(load(rgba, i), rbDir, gDir, bias);
+            __m256i t6 = _mm256_add_epi32(_mm256_slli_epi32(t, 2), _mm256_slli_epi32(t, 1));
+            v[i] = _mm256_add_epi32(three, _mm256_add_epi32(_mm256_cmpgt_epi32(step1, t6),
+                _mm256_add_epi32(_mm256_cmpgt_epi32(step3, t6), _mm256_cmpgt_epi32(step5, t6))));
+        }
+        storeBytes(v[0], v[1], levels);
+    }
+
+    int nearestColors(const uint8_t* rgba, const int palette[4][3], uint8_t indices[16]) {
+        __m256i rbColor[4], gColor[4];
+        for (int k = 0; k < 4; ++k) {
+            rbColor[k] = pair(palette[k][0], palette[k][2]);
+            gColor[k] = pair(palette[k][1], 0);
+        }
+        __m256i error = _mm256_setzero_si256();
+        __m256i v[2];
+        for (int i = 0; i < 2; ++i) {
+            __m256i p = load(rgba, i);
+            __m256i rb = _mm256_and_si256(p, _mm256_set1_epi32(0x00ff00ff));
+            __m256i g = channel(p, 8);
+            __m256i best = _mm256_set1_epi32(0x7fffffff);
+            __m256i bestIndex = _mm256_setzero_si256();
+            for (int k = 0; k < 4; ++k) {
+                __m256i drb = _mm256_sub_epi16(rb, rbColor[k]);
+                __m256i dg = _mm256_sub_epi16(g, gColor[k]);
+                __m256i distance = _mm256_add_epi32(_mm256_madd_epi16(drb, drb), _mm256_madd_epi16(dg, dg));
+                __m256i closer = _mm256_cmpgt_epi32(best, distance);
+                best = _mm256_blendv_epi8(best, distance, closer);
+                bestIndex = _mm256_blendv_epi8(bestIndex, _mm256_set1_epi32(k), closer);
+            }
+            error = _mm256_add_epi32(error, best);
+            v[i] = bestIndex;
+        }
+        storeBytes(v[0], v[1], indices);
+        return horizontalSum(error);
+    }
+
+    void alphaLevels(const uint8_t* rgba, int amin, int amax, uint8_t levels[16]) {
+        int range = amax - amin;
+        __m256i base = _mm256_set1_epi32(amin);
+        __m256i seven = _mm256_set1_epi32(7);
+        __m256i v[2];
+        for (int i = 0; i < 2; ++i) {
+            __m256i t = _mm256_sub_epi32(_mm256_srli_epi32(load(rgba, i), 24), base);
+            __m256i t14 = _mm256_sub_epi32(_mm256_slli_epi32(t, 4), _mm256_slli_epi32(t, 1));
+            __m256i level = seven;
+            for (int k = 1; k < 8; ++k) {
+                level = _mm256_add_epi32(level, _mm256_cmpgt_epi32(_mm256_set1_epi32((2 * k - 1) * range), t14));
+            }
+            v[i] = level;
+        }
+        storeBytes(v[0], v[1], levels);
+    }
+
+    void expand(const uint32_t* palette, int entries, const uint8_t indices[16], uint32_t keep, uint32_t out[16]) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices));
+        __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(palette));
+        __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(palette) + 1);
+        __m256i kept = _mm256_set1_epi32(static_cast<int>(keep));
+        __m256i seven = _mm256_set1_epi32(7);
+        for (int i = 0; i < 2; ++i) {
+            __m256i index = _mm256_cvtepu8_epi32(i == 0 ? bytes : _mm_srli_si128(bytes, 8));
+            __m256i v = _mm256_permutevar8x32_epi32(low, index);
+            if (entries > 8) {
+                v = _mm256_blendv_epi8(v, _mm256_permutevar8x32_epi32(high, index), _mm256_cmpgt_epi32(index, seven));
+            }
+            __m256i* dst = reinterpret_cast<__m256i*>(out) + i;
+            _mm256_storeu_si256(dst, _mm256_or_si256(_mm256_and_si256(_mm256_loadu_si256(dst), kept), v));
+        }
+    }
+
+    void interpolate(uint32_t e0, uint32_t e1, const uint8_t* weights, int count, uint32_t* out) {
+        __m256i a = _mm256_cvtepu8_epi16(_mm_set1_epi32(static_cast<int>(e0)));
+        __m256i b = _mm256_cvtepu8_epi16(_mm_set1_epi32(static_cast<int>(e1)));
+        __m256i full = _mm256_set1_epi16(64);
+        __m256i half = _mm256_set1_epi16(32);
+        for (int k = 0; k < count; k += 4) {
+            short w0 = weights[k], w1 = weights[k + 1], w2 = weights[k + 2], w3 = weights[k + 3];
+            __m256i w = _mm256_set_epi16(w3, w3, w3, w3, w2, w2, w2, w2, w1, w1, w1, w1, w0, w0, w0, w0);
+            __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(a, _mm256_sub_epi16(full, w)), _mm256_mullo_epi16(b, w));
+            __m256i r = _mm256_srli_epi16(_mm256_add_epi16(sum, half), 6);
+            // packus works per 128 bit lane: entries 0 1 land in qword 0, 2 3 in qword 2
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(r, r), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + k), _mm256_castsi256_si128(packed));
+        }
+    }
+}
+
+const GpuVideoBlockKernels& gpuVideoBlockKernelsAvx2() {
+    static const GpuVideoBlockKernels kernels = {
+        stats,
+        dots,
+        colorLevels,
+        nearestColors,
+        alphaLevels,
+        expand,
+        interpolate
+    };
+    return kernels;
+}
+
+#endif
@@ -0,0 +1,128 @@
+//
+//  GpuVideoBlockKernelsScalar.cpp
+//
+//  Reference block kernels, and the table lookup by instruction set.
+//
+
+#include "GpuVideoBlockKernels.h"
+
+#include <algorithm>
+
+namespace {
+    void stats(const uint8_t* rgba, GpuVideoBlockStats* out) {
+        GpuVideoBlockStats s = {};
+        for (int c = 0; c < 4; ++c) {
+            s.min[c] = 255;
+        }
+        for (int i = 0; i < 16; ++i) {
+            const uint8_t* p = rgba + i * 4;
+            for (int c = 0; c < 4; ++c) {
+                s.min[c] = std::min<int>(s.min[c], p[c]);
+                s.max[c] = std::max<int>(s.max[c], p[c]);
+                s.sum[c] += p[c];
+            }
+            s.rr += p[0] * p[0];
+            s.gg += p[1] * p[1];
+            s.bb += p[2] * p[2];
+            s.rg += p[0] * p[1];
+            s.rb += p[0] * p[2];
+            s.gb += p[1] * p[2];
+        }
+        *out = s;
+    }
+    void dots(const uint8_t* rgba, const int base[3], const int dir[3], int32_t out[16]) {
+        for (int i = 0; i < 16; ++i) {
+            const uint8_t* p = rgba + i * 4;
+            out[i] = (p[0] - base[0]) * dir[0] + (p[1] - base[1]) * dir[1] + (p[2] - base[2]) * dir[2];
+        }
+    }
+    void colorLevels(const uint8_t* rgba, const int c0[3], const int c1[3], uint8_t levels[16]) {
+        int d[3] = { c1[0] - c0[0], c1[1] - c0[1], c1[2] - c0[2] };
+        int len2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+        int32_t t[16];
+        dots(rgba, c0, d, t);
+        // round(3 t / len2) without dividing
+        for (int i = 0; i < 16; ++i) {
+            int t6 = t[i] * 6;
+            levels[i] = static_cast<uint8_t>((len2 <= t6) + (3 * len2 <= t6) + (5 * len2 <= t6));
+        }
+    }
+    int nearestColors(const uint8_t* rgba, const int palette[4][3], uint8_t indices[16]) {
+        int error = 0;
+        for (int i = 0; i < 16; ++i) {
+            const uint8_t* p = rgba + i * 4;
+            int best = 0;
+            int bestDistance = 0x7fffffff;
+            for (int k = 0; k < 4; ++k) {
+                int dr = p[0] - palette[k][0];
+                int dg = p[1] - palette[k][1];
+                int db = p[2] - palette[k][2];
+                int distance = dr * dr + dg * dg + db * db;
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = k;
+                }
+            }
+            indices[i] = static_cast<uint8_t>(best);
+            error += bestDistance;
+        }
+        return error;
+    }
+    void alphaLevels(const uint8_t* rgba, int amin, int amax, uint8_t levels[16]) {
+        int range = amax - amin;
+        for (int i = 0; i < 16; ++i) {
+            // round(7 t / range) without dividing
+            int t14 = (rgba[i * 4 + 3] - amin) * 14;
+            int level = 0;
+            for (int k = 1; k < 8; ++k) {
+                level += (2 * k - 1) * range <= t14;
+            }
+            levels[i] = static_cast<uint8_t>(level);
+        }
+    }
+
+    void expand(const uint32_t* palette, int entries, const uint8_t indices[16], uint32_t keep, uint32_t out[16]) {
+        (void)entries;
+        for (int i = 0; i < 16; ++i) {
+            out[i] = (out[i] & keep) | palette[indices[i]];
+        }
+    }
+    void interpolate(uint32_t e0, uint32_t e1, const uint8_t* weights, int count, uint32_t* out) {
+        for (int k = 0; k < count; ++k) {
+            uint32_t w = weights[k];
+            uint32_t v = 0;
+            for (int c = 0; c < 32; c += 8) {
+                uint32_t a = (e0 >> c) & 0xff;
+                uint32_t b = (e1 >> c) & 0xff;
+                v |= ((a * (64 - w) + b * w + 32) >> 6) << c;
+            }
+            out[k] = v;
+        }
+    }
+}
+
+const GpuVideoBlockKernels& gpuVideoBlockKernelsScalar() {
+    static const GpuVideoBlockKernels kernels = {
+        stats,
+        dots,
+        colorLevels,
+        nearestColors,
+        alphaLevels,
+        expand,
+        interpolate
+    };
+    return kernels;
+}
+
+const GpuVideoBlockKernels& gpuVideoBlockKernels(int isa) {
+#if defined(GPU_VIDEO_BLOCK_KERNELS_X86)
+    if (isa == 2) {
+        return gpuVideoBlockKernelsAvx2();
+    }
+    if (isa == 1) {
+        return gpuVideoBlockKernelsSse2();
+    }
+#endif
+    (void)isa;
+    return gpuVideoBlockKernelsScalar();
+}
@@ -0,0 +1,225 @@
+//
+//  GpuVideoBlockKernelsSse2.cpp
+//
+//  SSE2 block kernels, four pixels per register.
+//
+
+#include "GpuVideoBlockKernels.h"
+
+#if defined(GPU_VIDEO_BLOCK_KERNELS_X86)
+
+#include <emmintrin.h>
+
+namespace {
+    /*
+     Each 32 bit lane holds one RGBA8 pixel. Masking gives int16 pairs
+     (r, b) and (g, a), or a single channel with a zero upper half, so
+     _mm_madd_epi16 computes per pixel dot products in pixel order.
+     */
+    inline __m128i channel(__m128i pixels, int shift) {
+        return _mm_and_si128(_mm_srli_epi32(pixels, shift), _mm_set1_epi32(0xff));
+    }
+    inline __m128i pair(int lo, int hi) {
+        return _mm_set1_epi32(static_cast<int>((static_cast<uint32_t>(hi) << 16) | (static_cast<uint32_t>(lo) & 0xffff)));
+    }
+    inline int horizontalSum(__m128i v) {
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(v);
+    }
+    // 16 int32 (4 registers, pixel order) to 16 bytes
+    inline void storeBytes(__m128i v0, __m128i v1, __m128i v2, __m128i v3, uint8_t out[16]) {
+        __m128i lo = _mm_packs_epi32(v0, v1);
+        __m128i hi = _mm_packs_epi32(v2, v3);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(lo, hi));
+    }
+    inline __m128i load(const uint8_t* rgba, int i) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba) + i);
+    }
+    inline __m128i dot(__m128i pixels, __m128i rbDir, __m128i gDir, __m128i bias) {
+        __m128i rb = _mm_and_si128(pixels, _mm_set1_epi32(0x00ff00ff));
+        __m128i g = channel(pixels, 8);
+        return _mm_sub_epi32(_mm_add_epi32(_mm_madd_epi16(rb, rbDir), _mm_madd_epi16(g, gDir)), bias);
+    }
+
+    void stats(const uint8_t* rgba, GpuVideoBlockStats* out) {
+        __m128i mn = _mm_set1_epi8(-1);
+        __m128i mx = _mm_setzero_si128();
+        __m128i sum[4] = {};
+        __m128i rr = _mm_setzero_si128(), gg = rr, bb = rr, rg = rr, rb = rr, gb = rr;
+        for (int i = 0; i < 4; ++i) {
+            __m128i p = load(rgba, i);
+            mn = _mm_min_epu8(mn, p);
+            mx = _mm_max_epu8(mx, p);
+            __m128i r = channel(p, 0), g = channel(p, 8), b = channel(p, 16), a = _mm_srli_epi32(p, 24);
+            sum[0] = _mm_add_epi32(sum[0], r);
+            sum[1] = _mm_add_epi32(sum[1], g);
+            sum[2] = _mm_add_epi32(sum[2], b);
+            sum[3] = _mm_add_epi32(sum[3], a);
+            rr = _mm_add_epi32(rr, _mm_madd_epi16(r, r));
+            gg = _mm_add_epi32(gg, _mm_madd_epi16(g, g));
+            bb = _mm_add_epi32(bb, _mm_madd_epi16(b, b));
+            rg = _mm_add_epi32(rg, _mm_madd_epi16(r, g));
+            rb = _mm_add_epi32(rb, _mm_madd_epi16(r, b));
+            gb = _mm_add_epi32(gb, _mm_madd_epi16(g, b));
+        }
+        mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 8));
+        mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 4));
+        mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 8));
+        mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 4));
+        uint32_t mnBits = static_cast<uint32_t>(_mm_cvtsi128_si32(mn));
+        uint32_t mxBits = static_cast<uint32_t>(_mm_cvtsi128_si32(mx));
+        for (int c = 0; c < 4; ++c) {
+            out->min[c] = (mnBits >> (c * 8)) & 0xff;
+            out->max[c] = (mxBits >> (c * 8)) & 0xff;
+            out->sum[c] = horizontalSum(sum[c]);
+        }
+        out->rr = horizontalSum(rr);
+        out->gg = horizontalSum(gg);
+        out->bb = horizontalSum(bb);
+        out->rg = horizontalSum(rg);
+        out->rb = horizontalSum(rb);
+        out->gb = horizontalSum(gb);
+    }
+
+    void dots(const uint8_t* rgba, const int base[3], const int dir[3], int32_t out[16]) {
+        __m128i rbDir = pair(dir[0], dir[2]);
+        __m128i gDir = pair(dir[1], 0);
+        __m128i bias = _mm_set1_epi32(base[0] * dir[0] + base[1] * dir[1] + base[2] * dir[2]);
+        for (int i = 0; i < 4; ++i) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out) + i, dot(load(rgba, i), rbDir, gDir, bias));
+        }
+    }
+
+    void colorLevels(const uint8_t* rgba, const int c0[3], const int c1[3], uint8_t levels[16]) {
+        int d[3] = { c1[0] - c0[0], c1[1] - c0[1], c1[2] - c0[2] };
+        int len2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+        __m128i rbDir = pair(d[0], d[2]);
+        __m128i gDir = pair(d[1], 0);
+        __m128i bias = _mm_set1_epi32(c0[0] * d[0] + c0[1] * d[1] + c0[2] * d[2]);
+        __m128i step1 = _mm_set1_epi32(len2), step3 = _mm_set1_epi32(3 * len2), step5 = _mm_set1_epi32(5 * len2);
+        __m128i three = _mm_set1_epi32(3);
+        __m128i v[4];
+        for (int i = 0; i < 4; ++i) {
+            __m128i t = dot(load(rgba, i), rbDir, gDir, bias);
+            __m128i t6 = _mm_add_epi32(_mm_slli_epi32(t, 2), _mm_slli_epi32(t, 1));
+            // step > t6 is -1, so 3 + the three compares counts the steps <= t6
+            v[i] = _mm_add_epi32(three, _mm_add_epi32(_mm_cmpgt_epi32(step1, t6),
+                _mm_add_epi32(_mm_cmpgt_epi32(step3, t6), _mm_cmpgt_epi32(step5, t6))));
+        }
+        storeBytes(v[0], v[1], v[2], v[3], levels);
+    }
+
+    int nearestColors(const uint8_t* rgba, const int palette[4][3], uint8_t indices[16]) {
+        __m128i rbColor[4], gColor[4];
+        for (int k = 0; k < 4; ++k) {
+            rbColor[k] = pair(palette[k][0], palette[k][2]);
+            gColor[k] = pair(palette[k][1], 0);
+        }
+        __m128i error = _mm_setzero_si128();
+        __m128i v[4];
+        for (int i = 0; i < 4; ++i) {
+            __m128i p = load(rgba, i);
+            __m128i rb = _mm_and_si128(p, _mm_set1_epi32(0x00ff00ff));
+            __m128i g = channel(p, 8);
+            __m128i best = _mm_set1_epi32(0x7fffffff);
+            __m128i bestIndex = _mm_setzero_si128();
+            for (int k = 0; k < 4; ++k) {
+                __m128i drb = _mm_sub_epi16(rb, rbColor[k]);
+                __m128i dg = _mm_sub_epi16(g, gColor[k]);
+                __m128i distance = _mm_add_epi32(_mm_madd_epi16(drb, drb), _mm_madd_epi16(dg, dg));
+                __m128i closer = _mm_cmplt_epi32(distance, best);
+                best = _mm_or_si128(_mm_and_si128(closer, distance), _mm_andnot_si128(closer, best));
+                bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(k)), _mm_andnot_si128(closer, bestIndex));
+            }
+            error = _mm_add_epi32(error, best);
+            v[i] = bestIndex;
+        }
+        storeBytes(v[0], v[1], v[2], v[3], indices);
+        return horizontalSum(error);
+    }
+
+    void alphaLevels(const uint8_t* rgba, int amin, int amax, uint8_t levels[16]) {
+        int range = amax - amin;
+        __m128i base = _mm_set1_epi32(amin);
+        __m128i seven = _mm_set1_epi32(7);
+        __m128i v[4];
+        for (int i = 0; i < 4; ++i) {
+            __m128i t = _mm_sub_epi32(_mm_srli_epi32(load(rgba, i), 24), base);
+            __m128i t14 = _mm_sub_epi32(_mm_slli_epi32(t, 4), _mm_slli_epi32(t, 1));
+            __m128i level = seven;
+            for (int k = 1; k < 8; ++k) {
+                level = _mm_add_epi32(level, _mm_cmpgt_epi32(_mm_set1_epi32((2 * k - 1) * range), t14));
+            }
+            v[i] = level;
+        }
+        storeBytes(v[0], v[1], v[2], v[3], levels);
+    }
+
+    void expand(const uint32_t* palette, int entries, const uint8_t indices[16], uint32_t keep, uint32_t out[16]) {
+        if (entries > 8) {
+            // 16 compares per word cost more than the loads
+            for (int i = 0; i < 16; ++i) {
+                out[i] = (out[i] & keep) | palette[indices[i]];
+            }
+            return;
+        }
+        __m128i zero = _mm_setzero_si128();
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices));
+        __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+        __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+        __m128i index[4] = {
+            _mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+            _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)
+        };
+        __m128i v[4] = { zero, zero, zero, zero };
+        // No variable shuffle in SSE2: select each palette entry by compare.
+        for (int k = 0; k < entries; ++k) {
+            __m128i color = _mm_set1_epi32(static_cast<int>(palette[k]));
+            __m128i key = _mm_set1_epi32(k);
+            for (int i = 0; i < 4; ++i) {
+                v[i] = _mm_or_si128(v[i], _mm_and_si128(_mm_cmpeq_epi32(index[i], key), color));
+            }
+        }
+        __m128i kept = _mm_set1_epi32(static_cast<int>(keep));
+        for (int i = 0; i < 4; ++i) {
+            __m128i* dst = reinterpret_cast<__m128i*>(out) + i;
+            _mm_storeu_si128(dst, _mm_or_si128(_mm_and_si128(_mm_loadu_si128(dst), kept), v[i]));
+        }
+    }
+
+    void interpolate(uint32_t e0, uint32_t e1, const uint8_t* weights, int count, uint32_t* out) {
+        __m128i zero = _mm_setzero_si128();
+        __m128i a = _mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(e0)), zero);
+        __m128i b = _mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(e1)), zero);
+        a = _mm_unpacklo_epi64(a, a);
+        b = _mm_unpacklo_epi64(b, b);
+        __m128i full = _mm_set1_epi16(64);
+        __m128i half = _mm_set1_epi16(32);
+        for (int k = 0; k < count; k += 4) {
+            __m128i r[2];
+            for (int j = 0; j < 2; ++j) {
+                short w0 = weights[k + j * 2], w1 = weights[k + j * 2 + 1];
+                __m128i w = _mm_set_epi16(w1, w1, w1, w1, w0, w0, w0, w0);
+                __m128i sum = _mm_add_epi16(_mm_mullo_epi16(a, _mm_sub_epi16(full, w)), _mm_mullo_epi16(b, w));
+                r[j] = _mm_srli_epi16(_mm_add_epi16(sum, half), 6);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + k), _mm_packus_epi16(r[0], r[1]));
+        }
+    }
+}
+
+const GpuVideoBlockKernels& gpuVideoBlockKernelsSse2() {
+    static const GpuVideoBlockKernels kernels = {
+        stats,
+        dots,
+        colorLevels,
+        nearestColors,
+        alphaLevels,
+        expand,
+        interpolate
+    };
+    return kernels;
+}
+
+#endif
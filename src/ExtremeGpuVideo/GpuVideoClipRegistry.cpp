@@ -0,0 +1,129 @@
+//
+//  GpuVideoClipRegistry.cpp
+//
+//  Process wide sharing of everything built from a .gv file.
+//
+
+#include "GpuVideoClipRegistry.h"
+
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _MSC_VER
+#include <stdlib.h>
+#else
+#include <climits>
+#include <cstdlib>
+#endif
+
+namespace {
+    struct RegistryEntry {
+        std::weak_ptr<void> object;
+        // Serializes create() per key without blocking other keys.
+        std::shared_ptr<std::mutex> creating = std::make_shared<std::mutex>();
+    };
+
+    std::mutex& registryMutex() {
+        static std::mutex m;
+        return m;
+    }
+    std::map<std::string, RegistryEntry>& registry() {
+        static std::map<std::string, RegistryEntry> m;
+        return m;
+    }
+
+    // Caller holds registryMutex().
+    void sweep(std::map<std::string, RegistryEntry>& entries) {
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (it->second.object.expired() && it->second.creating.use_count() == 1) {
+                it = entries.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+}
+
+GpuVideoFileIdentity GpuVideoFileIdentity::of(const char* path) {
+    GpuVideoFileIdentity id;
+#ifdef _MSC_VER
+    char resolved[_MAX_PATH];
+    if (_fullpath(resolved, path, _MAX_PATH) == nullptr) {
+        throw std::runtime_error("file not found");
+    }
+    struct _stat64 st;
+    if (_stat64(resolved, &st) != 0) {
+        throw std::runtime_error("file not found");
+    }
+#else
+    char resolved[PATH_MAX];
+    if (realpath(path, resolved) == nullptr) {
+        throw std::runtime_error("file not found");
+    }
+    struct stat st;
+    if (stat(resolved, &st) != 0) {
+        throw std::runtime_error("file not found");
+    }
+#endif
+    id.path = resolved;
+    id.size = static_cast<uint64_t>(st.st_size);
+    id.mtime = static_cast<int64_t>(st.st_mtime);
+    return id;
+}
+std::string GpuVideoFileIdentity::key() const {
+    return path + "|" + std::to_string(size) + "|" + std::to_string(mtime);
+}
+
+std::shared_ptr<void> GpuVideoClipRegistry::acquireShared(const std::string& key, const std::function<std::shared_ptr<void>()>& create) {
+    std::shared_ptr<std::mutex> creating;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        RegistryEntry& entry = registry()[key];
+        std::shared_ptr<void> object = entry.object.lock();
+        if (object) {
+            return object;
+        }
+        creating = entry.creating;
+    }
+
+    std::unique_lock<std::mutex> createLock(*creating);
+    {
+        // Somebody else may have finished it while we waited.
+        std::lock_guard<std::mutex> lock(registryMutex());
+        std::shared_ptr<void> object = registry()[key].object.lock();
+        if (object) {
+            return object;
+        }
+    }
+
+    std::shared_ptr<void> object;
+    try {
+        object = create();
+    }
+    catch (...) {
+        // The lookup above added the entry; drop it unless a waiter is about to retry.
+        createLock.unlock();
+        creating.reset();
+        std::lock_guard<std::mutex> lock(registryMutex());
+        sweep(registry());
+        throw;
+    }
+
+    std::lock_guard<std::mutex> lock(registryMutex());
+    registry()[key].object = object;
+    sweep(registry());
+    return object;
+}
+
+size_t GpuVideoClipRegistry::getLiveCount() {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    size_t count = 0;
+    for (const auto& entry : registry()) {
+        count += entry.second.object.expired() ? 0 : 1;
+    }
+    return count;
+}
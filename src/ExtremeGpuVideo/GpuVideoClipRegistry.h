@@ -0,0 +1,46 @@
+//
+//  GpuVideoClipRegistry.h
+//
+//  Process wide sharing of everything built from a .gv file.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+/**
+ * A file as it is on disk right now: editing or replacing it changes the identity.
+ */
+struct GpuVideoFileIdentity {
+    std::string path;   // canonical
+    uint64_t size = 0;
+    int64_t mtime = 0;
+
+    // Throws std::runtime_error when the file does not exist.
+    static GpuVideoFileIdentity of(const char* path);
+    std::string key() const;
+};
+
+/**
+ * Refcounted registry of objects built from a file (readers, decompressed
+ * frames, GPU textures), keyed on the file identity and a kind string.
+ * Entries only hold weak references: the object goes away with its last user.
+ */
+class GpuVideoClipRegistry {
+public:
+    // Returns the live object for (file, kind), or the one create() builds.
+    // Concurrent callers for the same key wait for a single create() instead of repeating it;
+    // if create() throws, the exception reaches that caller and the next one retries.
+    template <class T>
+    static std::shared_ptr<T> acquire(const GpuVideoFileIdentity& file, const char* kind, const std::function<std::shared_ptr<T>()>& create) {
+        return std::static_pointer_cast<T>(acquireShared(file.key() + "|" + kind, [&create]() -> std::shared_ptr<void> { return create(); }));
+    }
+
+    // Number of objects currently shared through the registry.
+    static size_t getLiveCount();
+private:
+    static std::shared_ptr<void> acquireShared(const std::string& key, const std::function<std::shared_ptr<void>()>& create);
+};
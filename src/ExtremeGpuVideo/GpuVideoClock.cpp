@@ -0,0 +1,85 @@
+//
+//  GpuVideoClock.cpp
+//
+//  Maps absolute time to the frame that should be on screen.
+//
+
+#include "GpuVideoClock.h"
+
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+    // When the cook rate is a multiple of the clip rate, due times land exactly on frame
+    // boundaries; without a little slack rounding alternates a repeat and a drop.
+    const double kBoundaryEpsilon = 1.0e-4;
+}
+
+GpuVideoClock::GpuVideoClock() {
+}
+
+void GpuVideoClock::reset(uint32_t frameCount, float framePerSecond, double seconds) {
+    _frameCount = static_cast<int>(frameCount);
+    _framePerSecond = framePerSecond;
+    _presented = 0;
+    _dropped = 0;
+    _repeated = 0;
+    seek(0.0, seconds);
+}
+
+void GpuVideoClock::seek(double frame, double seconds) {
+    _anchorSeconds = seconds;
+    _anchorPosition = frame;
+    _index = static_cast<int64_t>(std::floor(frame));
+    _frame = -1;
+}
+
+void GpuVideoClock::setSpeed(float speed, double seconds) {
+    if (speed == _speed) {
+        return;
+    }
+    double position = getPosition(seconds);
+    _anchorSeconds = seconds;
+    _speed = speed;
+
+    // Fold whole loops out of the anchor so the position stays small and exact.
+    if (0 < _frameCount) {
+        double loops = std::floor(position / _frameCount);
+        position -= loops * _frameCount;
+        _index -= static_cast<int64_t>(loops) * _frameCount;
+    }
+    _anchorPosition = position;
+}
+
+double GpuVideoClock::getPosition(double seconds) const {
+    return _anchorPosition + (seconds - _anchorSeconds) * _framePerSecond * _speed;
+}
+
+int GpuVideoClock::update(double seconds) {
+    if (_frameCount <= 0) {
+        return 0;
+    }
+    if (seconds < _anchorSeconds) {
+        // The time source went backwards (e.g. it was restarted); carry on from here.
+        seek(_frame < 0 ? _anchorPosition : static_cast<double>(_frame), seconds);
+    }
+
+    int64_t index = static_cast<int64_t>(std::floor(getPosition(seconds) + kBoundaryEpsilon));
+    if (_frame < 0) {
+        ++_presented;
+    }
+    else {
+        int64_t delta = std::llabs(index - _index);
+        if (delta == 0) {
+            ++_repeated;
+        }
+        else {
+            ++_presented;
+            _dropped += static_cast<uint64_t>(delta - 1);
+        }
+    }
+    _index = index;
+
+    _frame = static_cast<int>(((index % _frameCount) + _frameCount) % _frameCount);
+    return _frame;
+}
@@ -0,0 +1,55 @@
+//
+//  GpuVideoClock.h
+//
+//  Maps absolute time to the frame that should be on screen.
+//
+
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Looping playback clock. The position is always derived from an anchor
+ * (time, frame) rather than accumulated per cook, so rounding never builds up
+ * and late cooks jump straight to the frame that is due instead of walking
+ * through the ones in between.
+ */
+class GpuVideoClock {
+public:
+    GpuVideoClock();
+
+    // Restarts at frame 0 and clears the counters.
+    void reset(uint32_t frameCount, float framePerSecond, double seconds);
+    void seek(double frame, double seconds);
+    // Re-anchors at the current position when the speed actually changes.
+    void setSpeed(float speed, double seconds);
+
+    // Frame due at seconds, in [0, frameCount). Updates the counters.
+    int update(double seconds);
+
+    int getFrame() const { return _frame; }
+    double getPosition(double seconds) const;
+    float getSpeed() const { return _speed; }
+
+    // Distinct frames handed out by update()
+    uint64_t getPresentedFrames() const { return _presented; }
+    // Frames the playhead passed over without them being shown (never decoded)
+    uint64_t getDroppedFrames() const { return _dropped; }
+    // update() calls that returned the previous frame again
+    uint64_t getRepeatedFrames() const { return _repeated; }
+private:
+    int _frameCount = 0;
+    double _framePerSecond = 0.0;
+    float _speed = 1.0f;
+
+    double _anchorSeconds = 0.0;
+    double _anchorPosition = 0.0;
+
+    // Unwrapped frame index of the last update(), for counting
+    int64_t _index = 0;
+    int _frame = -1;
+
+    uint64_t _presented = 0;
+    uint64_t _dropped = 0;
+    uint64_t _repeated = 0;
+};
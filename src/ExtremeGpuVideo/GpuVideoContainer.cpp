@@ -0,0 +1,165 @@
+//
+//  GpuVideoContainer.cpp
+//
+//  Parses the header, chunk table and frame index of v1 and v2 .gv files.
+//
+
+#include "GpuVideoContainer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace {
+    // Chunks this reader understands; any other chunk marked required makes the file unreadable.
+    bool isKnownChunk(uint32_t id) {
+        switch (id) {
+        case GPU_VIDEO_CHUNK_INDEX:
+        case GPU_VIDEO_CHUNK_STRIPS:
+        case GPU_VIDEO_CHUNK_CHECKSUMS:
+            return true;
+        }
+        return false;
+    }
+
+    std::string chunkName(uint32_t id) {
+        std::string name;
+        for (int i = 0; i < 4; ++i) {
+            char c = static_cast<char>(id >> (i * 8));
+            name += (' ' <= c && c <= '~') ? c : '?';
+        }
+        return name;
+    }
+}
+
+GpuVideoContainer GpuVideoContainer::parse(const ReadAt& readAt, uint64_t fileBytes) {
+    uint32_t magic = 0;
+    if (fileBytes < kRawMemoryAt || !readAt(&magic, sizeof(magic), 0)) {
+        throw std::runtime_error("invalid gv header");
+    }
+
+    GpuVideoContainer container;
+    container._fileBytes = fileBytes;
+    if (magic == kGpuVideoMagic) {
+        container.parseV2(readAt, fileBytes);
+    }
+    else {
+        container.parseV1(readAt, fileBytes);
+    }
+    container.checkBlocks();
+    return container;
+}
+
+void GpuVideoContainer::parseV1(const ReadAt& readAt, uint64_t fileBytes) {
+    uint8_t header[kRawMemoryAt];
+    if (!readAt(header, sizeof(header), 0)) {
+        throw std::runtime_error("invalid gv header");
+    }
+#define R(v, at) memcpy(&v, header + at, sizeof(v))
+    R(width, 0);
+    R(height, 4);
+    R(frameCount, 8);
+    R(fps, 12);
+    R(format, 16);
+    R(frameBytes, 20);
+#undef R
+
+    // The index fills the end of the file.
+    uint64_t indexBytes = sizeof(Lz4Block) * static_cast<uint64_t>(frameCount);
+    if (fileBytes < kRawMemoryAt + indexBytes) {
+        throw std::runtime_error("invalid gv index");
+    }
+    version = 1;
+    dataBegin = kRawMemoryAt;
+    dataEnd = fileBytes - indexBytes;
+    blocks.resize(frameCount);
+    if (!readAt(blocks.data(), indexBytes, dataEnd)) {
+        throw std::runtime_error("invalid gv index");
+    }
+}
+
+void GpuVideoContainer::parseV2(const ReadAt& readAt, uint64_t fileBytes) {
+    uint8_t header[kGpuVideoHeaderBytes];
+    if (fileBytes < sizeof(header) || !readAt(header, sizeof(header), 0)) {
+        throw std::runtime_error("invalid gv header");
+    }
+    uint32_t headerBytes = 0;
+    uint32_t chunkCount = 0;
+    uint64_t chunkTableAt = 0;
+#define R(v, at) memcpy(&v, header + at, sizeof(v))
+    R(version, 4);
+    R(headerBytes, 8);
+    R(width, 12);
+    R(height, 16);
+    R(frameCount, 20);
+    R(fps, 24);
+    R(format, 28);
+    R(frameBytes, 32);
+    R(chunkCount, 36);
+    R(chunkTableAt, 40);
+#undef R
+
+    if (version != kGpuVideoVersion) {
+        throw std::runtime_error("unsupported gv version " + std::to_string(version));
+    }
+    uint64_t tableBytes = sizeof(GpuVideoChunk) * static_cast<uint64_t>(chunkCount);
+    if (headerBytes < kGpuVideoHeaderBytes || fileBytes < headerBytes
+        || chunkTableAt < headerBytes || fileBytes < chunkTableAt || fileBytes - chunkTableAt < tableBytes) {
+        throw std::runtime_error("invalid gv header");
+    }
+    chunks.resize(chunkCount);
+    if (!readAt(chunks.data(), tableBytes, chunkTableAt)) {
+        throw std::runtime_error("invalid gv chunk table");
+    }
+
+    // Frames come first, so they end where the first chunk starts.
+    dataBegin = headerBytes;
+    dataEnd = chunkTableAt;
+    for (const GpuVideoChunk& chunk : chunks) {
+        if (chunk.address < headerBytes || fileBytes < chunk.address || fileBytes - chunk.address < chunk.size) {
+            throw std::runtime_error("invalid gv chunk " + chunkName(chunk.id));
+        }
+        if ((chunk.flags & GPU_VIDEO_CHUNK_REQUIRED) && !isKnownChunk(chunk.id)) {
+            throw std::runtime_error("gv chunk " + chunkName(chunk.id) + " needs a newer reader");
+        }
+        dataEnd = std::min(dataEnd, chunk.address);
+    }
+
+    const GpuVideoChunk* index = findChunk(GPU_VIDEO_CHUNK_INDEX);
+    if (index == nullptr || index->size != sizeof(Lz4Block) * static_cast<uint64_t>(frameCount)) {
+        throw std::runtime_error("invalid gv index");
+    }
+    blocks.resize(frameCount);
+    if (!readAt(blocks.data(), index->size, index->address)) {
+        throw std::runtime_error("invalid gv index");
+    }
+}
+
+void GpuVideoContainer::checkBlocks() const {
+    for (const Lz4Block& b : blocks) {
+        if (b.address < dataBegin || dataEnd < b.address || dataEnd - b.address < b.size) {
+            throw std::runtime_error("invalid gv index");
+        }
+    }
+}
+
+const GpuVideoChunk* GpuVideoContainer::findChunk(uint32_t id) const {
+    for (const GpuVideoChunk& chunk : chunks) {
+        if (chunk.id == id) {
+            return &chunk;
+        }
+    }
+    return nullptr;
+}
+
+std::vector<uint8_t> GpuVideoContainer::readChunk(const ReadAt& readAt, const GpuVideoChunk& chunk) const {
+    if (_fileBytes < chunk.address || _fileBytes - chunk.address < chunk.size) {
+        throw std::runtime_error("invalid gv chunk " + chunkName(chunk.id));
+    }
+    std::vector<uint8_t> payload(static_cast<size_t>(chunk.size));
+    if (!readAt(payload.data(), chunk.size, chunk.address)) {
+        throw std::runtime_error("invalid gv chunk " + chunkName(chunk.id));
+    }
+    return payload;
+}
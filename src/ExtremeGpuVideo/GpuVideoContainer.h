@@ -0,0 +1,49 @@
+//
+//  GpuVideoContainer.h
+//
+//  Parses the header, chunk table and frame index of v1 and v2 .gv files.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "GpuVideo.h"
+
+/**
+ * Everything a reader needs before its first frame, whichever container version the file uses.
+ * v1 files are reported as version 1 with no chunks.
+ */
+struct GpuVideoContainer {
+    // Fills dst with size bytes from address; false when the file is too short.
+    typedef std::function<bool(void* dst, uint64_t size, uint64_t address)> ReadAt;
+
+    uint32_t version = 1;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t frameCount = 0;
+    float fps = 0.0f;
+    GPU_COMPRESS format = GPU_COMPRESS_DXT1;
+    uint32_t frameBytes = 0;
+    // [dataBegin, dataEnd): where the lz4 blocks may lie
+    uint64_t dataBegin = kRawMemoryAt;
+    uint64_t dataEnd = 0;
+    std::vector<Lz4Block> blocks;
+    std::vector<GpuVideoChunk> chunks;
+
+    // Detects the version from the magic. Throws std::runtime_error on a malformed file.
+    static GpuVideoContainer parse(const ReadAt& readAt, uint64_t fileBytes);
+
+    // nullptr when the file has no such chunk
+    const GpuVideoChunk* findChunk(uint32_t id) const;
+    // Payload of a chunk, checked against the file size.
+    std::vector<uint8_t> readChunk(const ReadAt& readAt, const GpuVideoChunk& chunk) const;
+private:
+    void parseV1(const ReadAt& readAt, uint64_t fileBytes);
+    void parseV2(const ReadAt& readAt, uint64_t fileBytes);
+    void checkBlocks() const;
+
+    uint64_t _fileBytes = 0;
+};
@@ -0,0 +1,336 @@
+//
+//  GpuVideoFetchEngine.cpp
+//
+//  Asynchronous reads of frame data for every reader in the process: pread threads, or io_uring on Linux.
+//
+
+#include "GpuVideoFetchEngine.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define GPU_VIDEO_HAS_IO_URING 1
+#endif
+#endif
+
+#ifdef GPU_VIDEO_HAS_IO_URING
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+// Raw syscalls rather than liburing, which is not a dependency of this project.
+struct GpuVideoFetchEngine::Ring {
+    static const uint64_t kWake = ~0ull;
+
+    int fd = -1;
+    void* sq = MAP_FAILED;
+    size_t sqBytes = 0;
+    void* cq = MAP_FAILED;
+    size_t cqBytes = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesBytes = 0;
+    unsigned sqEntries = 0;
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    std::vector<iovec> iovecs;
+
+    // Null when the kernel (or a seccomp filter) says no.
+    static std::unique_ptr<Ring> open(unsigned entries, size_t slots) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) {
+            return nullptr;
+        }
+        std::unique_ptr<Ring> ring(new Ring());
+        ring->fd = fd;
+        ring->iovecs.resize(slots);
+        ring->sqEntries = params.sq_entries;
+        ring->sqBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        ring->cqBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) {
+            ring->sqBytes = ring->cqBytes = std::max(ring->sqBytes, ring->cqBytes);
+        }
+        ring->sq = mmap(nullptr, ring->sqBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (ring->sq == MAP_FAILED) {
+            return nullptr;
+        }
+        ring->cq = single ? ring->sq : mmap(nullptr, ring->cqBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ring->cq == MAP_FAILED) {
+            return nullptr;
+        }
+        ring->sqesBytes = params.sq_entries * sizeof(io_uring_sqe);
+        ring->sqes = static_cast<io_uring_sqe*>(mmap(nullptr, ring->sqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if (ring->sqes == MAP_FAILED) {
+            return nullptr;
+        }
+        uint8_t* sq = static_cast<uint8_t*>(ring->sq);
+        uint8_t* cq = static_cast<uint8_t*>(ring->cq);
+        ring->sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        ring->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        ring->sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        ring->sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        ring->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        ring->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        ring->cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return ring;
+    }
+    ~Ring() {
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, sqesBytes);
+        }
+        if (cq != MAP_FAILED && cq != sq) {
+            munmap(cq, cqBytes);
+        }
+        if (sq != MAP_FAILED) {
+            munmap(sq, sqBytes);
+        }
+        if (0 <= fd) {
+            close(fd);
+        }
+    }
+
+    // Every slot plus the wake up fits, and each push is entered right away, so the queue never fills.
+    void push(uint8_t opcode, int file, uint64_t user, uint64_t addr, uint32_t len, uint64_t offset) {
+        unsigned tail = *sqTail;
+        unsigned index = tail & *sqMask;
+        io_uring_sqe& sqe = sqes[index];
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = opcode;
+        sqe.fd = file;
+        sqe.addr = addr;
+        sqe.len = len;
+        sqe.off = offset;
+        sqe.user_data = user;
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        while (syscall(__NR_io_uring_enter, fd, 1, 0, 0, nullptr, 0) < 0 && errno == EINTR) {
+        }
+    }
+    void read(int slot, int file, void* dst, size_t bytes, uint64_t offset) {
+        iovec& iov = iovecs[slot];
+        iov.iov_base = dst;
+        iov.iov_len = bytes;
+        push(IORING_OP_READV, file, static_cast<uint64_t>(slot), reinterpret_cast<uint64_t>(&iov), 1, offset);
+    }
+    void wake() {
+        push(IORING_OP_NOP, -1, kWake, 0, 0, 0);
+    }
+    // Blocks for the next completion; false once woken by wake().
+    bool next(int& slot, int& result) {
+        for (;;) {
+            unsigned head = *cqHead;
+            if (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                const io_uring_cqe& cqe = cqes[head & *cqMask];
+                uint64_t user = cqe.user_data;
+                result = cqe.res;
+                __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+                if (user == kWake) {
+                    return false;
+                }
+                slot = static_cast<int>(user);
+                return true;
+            }
+            syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        }
+    }
+};
+#else
+struct GpuVideoFetchEngine::Ring {
+    static std::unique_ptr<Ring> open(unsigned entries, size_t slots) { return nullptr; }
+    void read(int slot, int file, void* dst, size_t bytes, uint64_t offset) {}
+    void wake() {}
+    bool next(int& slot, int& result) { return false; }
+};
+#endif
+
+namespace {
+    std::mutex s_sharedMutex;
+    GpuVideoFetchEngine* s_shared = nullptr;
+    uint32_t s_sharedDepth = 8;
+    bool s_sharedUring = false;
+}
+
+GpuVideoFetchEngine& GpuVideoFetchEngine::shared() {
+    std::lock_guard<std::mutex> lock(s_sharedMutex);
+    if (s_shared == nullptr) {
+        s_shared = new GpuVideoFetchEngine(s_sharedDepth, s_sharedUring);
+    }
+    return *s_shared;
+}
+
+void GpuVideoFetchEngine::configureShared(uint32_t queueDepth, bool uring) {
+    std::lock_guard<std::mutex> lock(s_sharedMutex);
+    s_sharedDepth = queueDepth;
+    s_sharedUring = uring;
+}
+
+void GpuVideoFetchEngine::shutdownShared() {
+    GpuVideoFetchEngine* engine = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(s_sharedMutex);
+        std::swap(engine, s_shared);
+    }
+    delete engine;
+}
+
+const char* GpuVideoFetchEngine::getSharedBackendName() {
+    std::lock_guard<std::mutex> lock(s_sharedMutex);
+    return s_shared ? s_shared->getBackendName() : "";
+}
+
+GpuVideoFetchEngine::GpuVideoFetchEngine(uint32_t queueDepth, bool uring) {
+    queueDepth = std::max(1u, queueDepth);
+    _slots.reset(new Slot[queueDepth]);
+    _slotCount = queueDepth;
+    for (uint32_t i = 0; i < queueDepth; ++i) {
+        _free.push_back(static_cast<int>(queueDepth - 1 - i));
+    }
+
+    if (uring) {
+        // One more entry for the wake up on shutdown.
+        _ring = Ring::open(queueDepth + 1, queueDepth);
+    }
+    if (_ring) {
+        _reaper = std::thread([this]() { reap(); });
+    }
+    else {
+        // Blocking reads: one thread per read in flight. They only wait on the disk,
+        // so they stay out of the pool.
+        for (uint32_t i = 0; i < queueDepth; ++i) {
+            _readers.emplace_back([this]() { io(); });
+        }
+    }
+}
+
+GpuVideoFetchEngine::~GpuVideoFetchEngine() {
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cond.wait(lock, [this]() { return _busy == 0; });
+        _quit = true;
+    }
+    _cond.notify_all();
+    if (_ring) {
+        _ring->wake();
+        _reaper.join();
+    }
+    for (std::thread& r : _readers) {
+        r.join();
+    }
+}
+
+void GpuVideoFetchEngine::submit(const Source& source, uint64_t address, uint64_t size, GpuVideoDeadline deadline, Done done) {
+    submit(source, address, size, deadline, nullptr, std::move(done));
+}
+
+void GpuVideoFetchEngine::submit(const Source& source, uint64_t address, uint64_t size, GpuVideoDeadline deadline, std::shared_ptr<GpuVideoAlignedBuffer> buffer, Done done) {
+    Request request;
+    request.source = &source;
+    request.address = address;
+    request.size = size;
+    request.deadline = deadline;
+    request.buffer = std::move(buffer);
+    request.done = std::move(done);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pending.push_back(std::move(request));
+        ++_busy;
+        if (_ring) {
+            pump();
+            return;
+        }
+    }
+    _cond.notify_all();
+}
+
+void GpuVideoFetchEngine::prepare(Slot& slot, Request& request) const {
+    uint64_t alignment = std::max(1u, request.source->alignment);
+    slot.begin = request.address / alignment * alignment;
+    uint64_t end = (request.address + request.size + alignment - 1) / alignment * alignment;
+    slot.want = end - slot.begin;
+    slot.got = 0;
+    GpuVideoAlignedBuffer& buffer = request.buffer ? *request.buffer : slot.buffer;
+    buffer.reserve(static_cast<size_t>(slot.want));
+    slot.data = buffer.data();
+    slot.request = std::move(request);
+}
+
+// Locked. Moves pending requests into free slots and onto the ring.
+void GpuVideoFetchEngine::pump() {
+    while (!_free.empty() && !_pending.empty()) {
+        int s = _free.back();
+        _free.pop_back();
+        Slot& slot = _slots[s];
+        prepare(slot, _pending.front());
+        _pending.pop_front();
+        _ring->read(s, slot.request.source->fd, slot.data, static_cast<size_t>(slot.want), slot.begin);
+    }
+}
+
+void GpuVideoFetchEngine::finish(int s) {
+    Slot& slot = _slots[s];
+    uint64_t skip = slot.request.address - slot.begin;
+    uint64_t bytes = slot.got > skip ? std::min(slot.got - skip, slot.request.size) : 0;
+    slot.request.done(slot.data + skip, bytes);
+    slot.request.done = Done();
+    slot.request.buffer.reset();
+
+    // Notified under the lock: once _busy reaches zero the destructor may run.
+    std::lock_guard<std::mutex> lock(_mutex);
+    _free.push_back(s);
+    --_busy;
+    if (_ring) {
+        pump();
+    }
+    _cond.notify_all();
+}
+
+void GpuVideoFetchEngine::reap() {
+    int s = 0;
+    int result = 0;
+    while (_ring->next(s, result)) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Slot& slot = _slots[s];
+        if (0 < result) {
+            slot.got += static_cast<uint64_t>(result);
+        }
+        // A buffered read may come back short mid file; an unbuffered one only at the end.
+        if (0 < result && slot.got < slot.want && slot.got % std::max(1u, slot.request.source->alignment) == 0) {
+            _ring->read(s, slot.request.source->fd, slot.data + slot.got, static_cast<size_t>(slot.want - slot.got), slot.begin + slot.got);
+            continue;
+        }
+        GpuVideoThreadPool::shared().submit([this, s]() { finish(s); }, slot.request.deadline);
+    }
+}
+
+void GpuVideoFetchEngine::io() {
+    for (;;) {
+        int s = -1;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cond.wait(lock, [this]() { return _quit || (!_pending.empty() && !_free.empty()); });
+            if (_pending.empty()) {
+                return;
+            }
+            s = _free.back();
+            _free.pop_back();
+            prepare(_slots[s], _pending.front());
+            _pending.pop_front();
+        }
+        Slot& slot = _slots[s];
+        slot.got = slot.request.source->pread(slot.data, static_cast<size_t>(slot.want), slot.begin);
+        GpuVideoThreadPool::shared().submit([this, s]() { finish(s); }, slot.request.deadline);
+    }
+}
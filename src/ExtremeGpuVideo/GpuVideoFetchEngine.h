@@ -0,0 +1,111 @@
+//
+//  GpuVideoFetchEngine.h
+//
+//  Asynchronous reads of frame data for every reader in the process: pread threads, or io_uring on Linux.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "GpuVideoIO.h"
+#include "GpuVideoThreadPool.h"
+
+/**
+ * Keeps up to queueDepth reads in flight, from any number of files, and hands each finished
+ * read to the shared GpuVideoThreadPool at the deadline it was submitted with. By default
+ * queueDepth I/O threads do blocking preads. With io_uring (opt in, Linux only) one thread
+ * reaps completions for the whole queue; it falls back to the threads where the kernel or a
+ * sandbox forbids the syscalls. Opt in only where a benchmark shows it pays off: on a single
+ * core reading from the page cache it was slower than pread (GpuVideoBench --queue).
+ * Thread safe. The destructor waits for every submitted read.
+ */
+class GpuVideoFetchEngine {
+public:
+    // Called once per submit() on a pool thread with the bytes read (fewer than asked on a short read).
+    // data is only valid during the call.
+    typedef std::function<void(const uint8_t* data, uint64_t bytes)> Done;
+    // Fallback reader, as GpuVideoIO::pread.
+    typedef std::function<std::size_t(void* dst, std::size_t size, uint64_t offset)> PRead;
+
+    // A file to read from. Must outlive every read submitted for it.
+    struct Source {
+        // descriptor for io_uring
+        int fd = -1;
+        PRead pread;
+        // Reads are widened to multiples of it (GpuVideoDirectIO::kAlignment for unbuffered files).
+        uint32_t alignment = 1;
+    };
+
+    // The engine every GpuVideoReader uses, created on first use with the settings of configureShared().
+    static GpuVideoFetchEngine& shared();
+    // Takes effect the next time shared() creates the engine.
+    static void configureShared(uint32_t queueDepth, bool uring);
+    // Waits for every read, joins the threads; the next shared() starts a new engine.
+    // Call before GpuVideoThreadPool::shutdownShared(), which completions go through.
+    static void shutdownShared();
+    // "io_uring" or "threads" for the shared engine, "" while there is none.
+    static const char* getSharedBackendName();
+
+    GpuVideoFetchEngine(uint32_t queueDepth, bool uring);
+    ~GpuVideoFetchEngine();
+
+    GpuVideoFetchEngine(const GpuVideoFetchEngine&) = delete;
+    void operator=(const GpuVideoFetchEngine&) = delete;
+
+    // Queues a read of [address, address + size) of source; never blocks. deadline orders done among other pool work.
+    void submit(const Source& source, uint64_t address, uint64_t size, GpuVideoDeadline deadline, Done done);
+    // Reads into buffer (grown as needed) instead of a staging slot, so the data outlives done.
+    void submit(const Source& source, uint64_t address, uint64_t size, GpuVideoDeadline deadline, std::shared_ptr<GpuVideoAlignedBuffer> buffer, Done done);
+
+    bool isUring() const { return _ring != nullptr; }
+    const char* getBackendName() const { return isUring() ? "io_uring" : "threads"; }
+    uint32_t getQueueDepth() const { return _slotCount; }
+private:
+    struct Request {
+        const Source* source = nullptr;
+        uint64_t address = 0;
+        uint64_t size = 0;
+        GpuVideoDeadline deadline;
+        std::shared_ptr<GpuVideoAlignedBuffer> buffer;
+        Done done;
+    };
+    // One read in flight and its staging buffer.
+    struct Slot {
+        Request request;
+        GpuVideoAlignedBuffer buffer;
+        uint64_t begin = 0;
+        uint8_t* data = nullptr;
+        uint64_t want = 0;
+        uint64_t got = 0;
+    };
+    struct Ring;
+
+    void prepare(Slot& slot, Request& request) const;
+    void finish(int slot);
+    void pump();
+    void reap();
+    void io();
+
+    std::unique_ptr<Ring> _ring;
+
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::unique_ptr<Slot[]> _slots;
+    uint32_t _slotCount = 0;
+    std::vector<int> _free;
+    std::deque<Request> _pending;
+    uint32_t _busy = 0;
+    bool _quit = false;
+
+    std::thread _reaper;
+    // Without io_uring: blocking reads, one per read in flight
+    std::vector<std::thread> _readers;
+};
@@ -8,6 +8,7 @@
 
 #pragma once
 #include <stdexcept>
+#include <algorithm>
 
 #ifndef _MSC_VER
 #define _FILE_OFFSET_BITS 64
@@ -16,6 +17,20 @@
 
 #include <cstdio>
 #include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#ifdef _MSC_VER
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <io.h>
+#include <malloc.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#endif
 
 class GpuVideoIO {
 public:
@@ -48,9 +63,189 @@ public:
 	std::size_t read(void* dst, std::size_t size) {
 		return fread(dst, 1, size, _fp);
 	}
+	// Positional read, safe to call from several threads at once. POSIX pread leaves the file
+	// position alone; on Windows the handle is not opened for overlapped I/O, so ReadFile at an
+	// offset still moves it (and concurrent calls are serialized). Either way the stdio position
+	// behind seek()/read()/write() is not kept in step: use one or the other on a GpuVideoIO,
+	// apart from seek()/tellg() to get the size before the first pread().
+	std::size_t pread(void* dst, std::size_t size, int64_t offset) const {
+		std::size_t done = 0;
+#ifdef _MSC_VER
+		HANDLE handle = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(_fp)));
+		while (done < size) {
+			OVERLAPPED overlapped = {};
+			uint64_t at = static_cast<uint64_t>(offset) + done;
+			overlapped.Offset = static_cast<DWORD>(at);
+			overlapped.OffsetHigh = static_cast<DWORD>(at >> 32);
+			DWORD chunk = static_cast<DWORD>(std::min<std::size_t>(size - done, 0x40000000));
+			DWORD n = 0;
+			if (ReadFile(handle, static_cast<uint8_t*>(dst) + done, chunk, &n, &overlapped) == FALSE || n == 0) {
+				break;
+			}
+			done += n;
+		}
+#else
+		int fd = fileno(_fp);
+		while (done < size) {
+			ssize_t n = ::pread(fd, static_cast<uint8_t*>(dst) + done, size - done, static_cast<off_t>(offset + done));
+			if (n <= 0) {
+				break;
+			}
+			done += static_cast<std::size_t>(n);
+		}
+#endif
+		return done;
+	}
 	std::size_t write(const void* src, size_t size) {
 		return fwrite(src, 1, size, _fp);
 	}
+	// POSIX descriptor for GpuVideoFetchEngine, -1 on Windows.
+	int descriptor() const {
+#ifdef _MSC_VER
+		return -1;
+#else
+		return fileno(_fp);
+#endif
+	}
 private:
 	FILE* _fp = nullptr;
+};
+
+// Read only file opened without the OS page cache (O_DIRECT, FILE_FLAG_NO_BUFFERING, F_NOCACHE).
+// Offsets, sizes and buffers passed to pread() must be multiples of kAlignment.
+// Where the file system refuses unbuffered I/O the file is opened normally and isDirect() is false.
+class GpuVideoDirectIO {
+public:
+	static const uint32_t kAlignment = 4096;
+
+	explicit GpuVideoDirectIO(const char* filename) {
+#ifdef _MSC_VER
+		_handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
+		_direct = _handle != INVALID_HANDLE_VALUE;
+		if (!_direct) {
+			_handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		}
+		if (_handle == INVALID_HANDLE_VALUE) {
+			throw std::runtime_error("file not found");
+		}
+#else
+#ifdef O_DIRECT
+		_fd = open(filename, O_RDONLY | O_DIRECT);
+		_direct = 0 <= _fd;
+#endif
+		if (_fd < 0) {
+			_fd = open(filename, O_RDONLY);
+		}
+		if (_fd < 0) {
+			throw std::runtime_error("file not found");
+		}
+#ifdef F_NOCACHE
+		_direct = fcntl(_fd, F_NOCACHE, 1) != -1;
+#endif
+#endif
+	}
+	~GpuVideoDirectIO() {
+#ifdef _MSC_VER
+		CloseHandle(_handle);
+#else
+		close(_fd);
+#endif
+	}
+	GpuVideoDirectIO(const GpuVideoDirectIO&) = delete;
+	void operator=(const GpuVideoDirectIO&) = delete;
+
+	bool isDirect() const { return _direct; }
+	// POSIX descriptor for GpuVideoFetchEngine, -1 on Windows.
+	int descriptor() const {
+#ifdef _MSC_VER
+		return -1;
+#else
+		return _fd;
+#endif
+	}
+
+	static uint64_t alignDown(uint64_t offset) { return offset & ~static_cast<uint64_t>(kAlignment - 1); }
+	static uint64_t alignUp(uint64_t offset) { return alignDown(offset + kAlignment - 1); }
+
+	// Positional read, thread safe (serialized on Windows, see GpuVideoIO::pread). Stops short at the end of the file.
+	std::size_t pread(void* dst, std::size_t size, int64_t offset) const {
+		std::size_t done = 0;
+		while (done < size) {
+#ifdef _MSC_VER
+			OVERLAPPED overlapped = {};
+			uint64_t at = static_cast<uint64_t>(offset) + done;
+			overlapped.Offset = static_cast<DWORD>(at);
+			overlapped.OffsetHigh = static_cast<DWORD>(at >> 32);
+			DWORD chunk = static_cast<DWORD>(std::min<std::size_t>(size - done, 0x40000000));
+			DWORD n = 0;
+			if (ReadFile(_handle, static_cast<uint8_t*>(dst) + done, chunk, &n, &overlapped) == FALSE || n == 0) {
+				break;
+			}
+#else
+			ssize_t n = ::pread(_fd, static_cast<uint8_t*>(dst) + done, size - done, static_cast<off_t>(offset + done));
+			if (n <= 0) {
+				break;
+			}
+#endif
+			done += static_cast<std::size_t>(n);
+			// A partial unbuffered read means the end of the file; the next offset would not be aligned.
+			if (_direct && done % kAlignment != 0) {
+				break;
+			}
+		}
+		return done;
+	}
+private:
+#ifdef _MSC_VER
+	HANDLE _handle = INVALID_HANDLE_VALUE;
+#else
+	int _fd = -1;
+#endif
+	bool _direct = false;
+};
+
+// Grow-only staging buffer aligned for GpuVideoDirectIO.
+class GpuVideoAlignedBuffer {
+public:
+	GpuVideoAlignedBuffer() {}
+	~GpuVideoAlignedBuffer() {
+		release();
+	}
+	GpuVideoAlignedBuffer(const GpuVideoAlignedBuffer&) = delete;
+	void operator=(const GpuVideoAlignedBuffer&) = delete;
+
+	uint8_t* data() const { return _data; }
+	std::size_t size() const { return _size; }
+
+	// Contents are not kept.
+	void reserve(std::size_t size) {
+		if (size <= _size) {
+			return;
+		}
+		release();
+		size = static_cast<std::size_t>(GpuVideoDirectIO::alignUp(size));
+#ifdef _MSC_VER
+		_data = static_cast<uint8_t*>(_aligned_malloc(size, GpuVideoDirectIO::kAlignment));
+#else
+		void* p = nullptr;
+		_data = posix_memalign(&p, GpuVideoDirectIO::kAlignment, size) == 0 ? static_cast<uint8_t*>(p) : nullptr;
+#endif
+		if (_data == nullptr) {
+			throw std::bad_alloc();
+		}
+		_size = size;
+	}
+private:
+	void release() {
+#ifdef _MSC_VER
+		_aligned_free(_data);
+#else
+		free(_data);
+#endif
+		_data = nullptr;
+		_size = 0;
+	}
+
+	uint8_t* _data = nullptr;
+	std::size_t _size = 0;
 };
\ No newline at end of file
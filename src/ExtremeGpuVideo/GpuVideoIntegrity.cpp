@@ -0,0 +1,133 @@
+//
+//  GpuVideoIntegrity.cpp
+//
+//  Per-frame XXH64 checksums (GPU_VIDEO_CHUNK_CHECKSUMS) and what is known to be corrupt.
+//
+
+#include "GpuVideoIntegrity.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "xxhash.h"
+#include "GpuVideoThreadPool.h"
+
+GpuVideoIntegrity::GpuVideoIntegrity(const std::vector<uint8_t>& checksums, uint32_t frameCount, Fetch fetch)
+    : _frameCount(frameCount)
+    , _status(new std::atomic<uint8_t>[frameCount])
+    , _readFailures(new std::atomic<uint32_t>[frameCount])
+    , _mode(GPU_VIDEO_VERIFY_OFF)
+    , _checked(0)
+    , _corrupt(0)
+    , _scrubbed(0)
+    , _fetch(fetch)
+    , _quit(false) {
+    if (!checksums.empty()) {
+        if (checksums.size() != sizeof(uint64_t) * static_cast<uint64_t>(frameCount)) {
+            throw std::runtime_error("invalid gv checksums");
+        }
+        _checksums.resize(frameCount);
+        memcpy(_checksums.data(), checksums.data(), checksums.size());
+    }
+    for (uint32_t i = 0; i < frameCount; ++i) {
+        _status[i] = FRAME_UNCHECKED;
+        _readFailures[i] = 0;
+    }
+}
+
+GpuVideoIntegrity::~GpuVideoIntegrity() {
+    close();
+}
+
+uint64_t GpuVideoIntegrity::hash(const void* data, uint64_t bytes) {
+    return XXH64(data, static_cast<size_t>(bytes), 0);
+}
+
+void GpuVideoIntegrity::setMode(GpuVideoVerify mode) {
+    _mode = mode;
+    if (mode != GPU_VIDEO_VERIFY_SCRUB || !hasChecksums()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_quit && _fetch && !_scrubStarted && _frameCount != 0) {
+        _scrubStarted = true;
+        _scrubbing = true;
+        GpuVideoThreadPool::shared().submit([this]() { scrub(0); }, gpuVideoBackground());
+    }
+}
+
+bool GpuVideoIntegrity::verify(int frame, const uint8_t* block, uint64_t bytes) {
+    bool ok = hash(block, bytes) == _checksums[frame];
+    record(frame, ok ? FRAME_OK : FRAME_CORRUPT);
+    return ok;
+}
+
+void GpuVideoIntegrity::markCorrupt(int frame) {
+    record(frame, FRAME_CORRUPT);
+}
+
+void GpuVideoIntegrity::record(int frame, FrameStatus status) {
+    uint8_t was = _status[frame].load();
+    for (;;) {
+        // Corrupt is final; OK only replaces unchecked.
+        if (was == FRAME_CORRUPT || was == status || (status == FRAME_OK && was != FRAME_UNCHECKED)) {
+            return;
+        }
+        if (_status[frame].compare_exchange_weak(was, status)) {
+            if (was == FRAME_UNCHECKED) {
+                ++_checked;
+            }
+            if (status == FRAME_CORRUPT) {
+                ++_corrupt;
+            }
+            return;
+        }
+    }
+}
+
+std::vector<int> GpuVideoIntegrity::getCorruptFrames() const {
+    std::vector<int> frames;
+    for (uint32_t i = 0; i < _frameCount; ++i) {
+        if (_status[i].load(std::memory_order_relaxed) == FRAME_CORRUPT) {
+            frames.push_back(static_cast<int>(i));
+        }
+    }
+    return frames;
+}
+
+float GpuVideoIntegrity::getScrubProgress() const {
+    if (!hasChecksums() || _frameCount == 0) {
+        return 1.f;
+    }
+    return static_cast<float>(_scrubbed.load()) / static_cast<float>(_frameCount);
+}
+
+void GpuVideoIntegrity::close() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _quit = true;
+    _idle.wait(lock, [this]() { return !_scrubbing; });
+    _fetch = Fetch();
+}
+
+void GpuVideoIntegrity::scrub(uint32_t i) {
+    if (!_quit) {
+        thread_local std::vector<uint8_t> buffer;
+        int frame = static_cast<int>(i);
+        if (getStatus(frame) == FRAME_UNCHECKED) {
+            // close() waits for this task before it drops the fetch, so the reader is still there.
+            // A frame that cannot be read right now stays unchecked rather than corrupt.
+            if (_fetch(frame, buffer)) {
+                verify(frame, buffer.data(), buffer.size());
+            }
+        }
+        ++_scrubbed;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_quit || _frameCount <= i + 1) {
+        _scrubbing = false;
+        _idle.notify_all();
+        return;
+    }
+    GpuVideoThreadPool::shared().submit([this, i]() { scrub(i + 1); }, gpuVideoBackground());
+}
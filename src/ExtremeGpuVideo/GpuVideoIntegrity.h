@@ -0,0 +1,99 @@
+//
+//  GpuVideoIntegrity.h
+//
+//  Per-frame XXH64 checksums (GPU_VIDEO_CHUNK_CHECKSUMS) and what is known to be corrupt.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+enum GpuVideoVerify : int {
+    // Nothing hashed; only reads that fail outright mark a frame corrupt.
+    GPU_VIDEO_VERIFY_OFF = 0,
+    // Each frame is hashed the first time it is read.
+    GPU_VIDEO_VERIFY_FIRST_DECODE = 1,
+    // A background task hashes the whole file once; reads only look the result up.
+    GPU_VIDEO_VERIFY_SCRUB = 2
+};
+
+/**
+ * Shared by a reader and whatever wraps it. Corrupt frames read back as zeros rather than garbage.
+ * Thread safe.
+ */
+class GpuVideoIntegrity {
+public:
+    enum FrameStatus : uint8_t {
+        FRAME_UNCHECKED,
+        FRAME_OK,
+        FRAME_CORRUPT
+    };
+
+    // Fills buffer with the lz4 block of frame for the scrub; false on a short read.
+    typedef std::function<bool(int frame, std::vector<uint8_t>& buffer)> Fetch;
+
+    // checksums: the chunk payload, empty when the file has none
+    GpuVideoIntegrity(const std::vector<uint8_t>& checksums, uint32_t frameCount, Fetch fetch);
+    ~GpuVideoIntegrity();
+
+    GpuVideoIntegrity(const GpuVideoIntegrity&) = delete;
+    void operator=(const GpuVideoIntegrity&) = delete;
+
+    static uint64_t hash(const void* data, uint64_t bytes);
+
+    bool hasChecksums() const { return !_checksums.empty(); }
+
+    // Switching to SCRUB starts the background pass unless one already ran.
+    void setMode(GpuVideoVerify mode);
+    GpuVideoVerify getMode() const { return _mode.load(std::memory_order_relaxed); }
+
+    FrameStatus getStatus(int frame) const { return static_cast<FrameStatus>(_status[frame].load(std::memory_order_relaxed)); }
+    // True when the current mode wants block (the frame's whole lz4 block) hashed before use.
+    bool wantsHash(int frame) const {
+        return getMode() == GPU_VIDEO_VERIFY_FIRST_DECODE && hasChecksums() && getStatus(frame) == FRAME_UNCHECKED;
+    }
+    // Hashes block against the stored checksum and records the result.
+    bool verify(int frame, const uint8_t* block, uint64_t bytes);
+    // A short read or an lz4 error.
+    void markCorrupt(int frame);
+    // A read that failed and left the frame black; says nothing about the file, so the frame is
+    // not marked. Counted per frame so a cache can tell the data it got came from a failed read.
+    void markReadFailed(int frame) { ++_readFailures[frame]; }
+    uint32_t getReadFailures(int frame) const { return _readFailures[frame].load(); }
+
+    // frames known to be OK or corrupt
+    uint32_t getCheckedCount() const { return _checked; }
+    uint32_t getCorruptCount() const { return _corrupt; }
+    std::vector<int> getCorruptFrames() const;
+    // Scrub progress, 0..1 (1 when there is nothing to scrub)
+    float getScrubProgress() const;
+
+    // Called by the owning reader before it goes away: stops the scrub, later ones are no-ops.
+    void close();
+private:
+    void record(int frame, FrameStatus status);
+    // One frame per pool task, so the scrub never holds a worker for long.
+    void scrub(uint32_t frame);
+
+    std::vector<uint64_t> _checksums;
+    uint32_t _frameCount = 0;
+    std::unique_ptr<std::atomic<uint8_t>[]> _status;
+    std::unique_ptr<std::atomic<uint32_t>[]> _readFailures;
+    std::atomic<GpuVideoVerify> _mode;
+    std::atomic<uint32_t> _checked;
+    std::atomic<uint32_t> _corrupt;
+    std::atomic<uint32_t> _scrubbed;
+
+    std::mutex _mutex;
+    Fetch _fetch;
+    std::condition_variable _idle;
+    bool _scrubStarted = false;
+    bool _scrubbing = false;
+    std::atomic<bool> _quit;
+};
@@ -0,0 +1,128 @@
+//
+//  GpuVideoMappedFile.cpp
+//
+//  Read-only memory mapping of a .gv file.
+//
+
+#include "GpuVideoMappedFile.h"
+#include "GpuVideoClipRegistry.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _MSC_VER
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+std::shared_ptr<GpuVideoMappedFile> GpuVideoMappedFile::open(const char* path) {
+    GpuVideoFileIdentity id = GpuVideoFileIdentity::of(path);
+    return GpuVideoClipRegistry::acquire<GpuVideoMappedFile>(id, "mapping", [&id]() {
+        return std::shared_ptr<GpuVideoMappedFile>(new GpuVideoMappedFile(id.path));
+    });
+}
+
+#ifdef _MSC_VER
+GpuVideoMappedFile::GpuVideoMappedFile(const std::string& path) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("file not found");
+    }
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file, &size) == FALSE || size.QuadPart == 0) {
+        CloseHandle(file);
+        throw std::runtime_error("file is empty");
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        throw std::runtime_error("file mapping failed");
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("file mapping failed");
+    }
+    _file = file;
+    _mapping = mapping;
+    _data = static_cast<const uint8_t*>(view);
+    _size = static_cast<uint64_t>(size.QuadPart);
+}
+GpuVideoMappedFile::~GpuVideoMappedFile() {
+    UnmapViewOfFile(_data);
+    CloseHandle(_mapping);
+    CloseHandle(_file);
+}
+void GpuVideoMappedFile::advise(uint64_t offset, uint64_t length, Advice advice) const {
+    if (_size <= offset || length == 0) {
+        return;
+    }
+#if _WIN32_WINNT >= 0x0602
+    if (advice == ADVICE_WILLNEED) {
+        WIN32_MEMORY_RANGE_ENTRY range;
+        range.VirtualAddress = const_cast<uint8_t*>(_data + offset);
+        range.NumberOfBytes = static_cast<SIZE_T>(std::min<uint64_t>(length, _size - offset));
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+#endif
+}
+#else
+GpuVideoMappedFile::GpuVideoMappedFile(const std::string& path) {
+    _fd = ::open(path.c_str(), O_RDONLY);
+    if (_fd < 0) {
+        throw std::runtime_error("file not found");
+    }
+    struct stat st;
+    if (fstat(_fd, &st) != 0 || st.st_size == 0) {
+        ::close(_fd);
+        throw std::runtime_error("file is empty");
+    }
+    // MAP_SHARED: every mapping of the file is backed by the same page cache pages.
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, _fd, 0);
+    if (view == MAP_FAILED) {
+        ::close(_fd);
+        throw std::runtime_error("file mapping failed");
+    }
+    _data = static_cast<const uint8_t*>(view);
+    _size = static_cast<uint64_t>(st.st_size);
+}
+GpuVideoMappedFile::~GpuVideoMappedFile() {
+    munmap(const_cast<uint8_t*>(_data), static_cast<size_t>(_size));
+    ::close(_fd);
+}
+void GpuVideoMappedFile::advise(uint64_t offset, uint64_t length, Advice advice) const {
+    if (_size <= offset || length == 0) {
+        return;
+    }
+    // madvise wants a page aligned start address.
+    static const uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uint64_t begin = offset - offset % pageSize;
+    uint64_t end = offset + length < _size ? offset + length : _size;
+
+    int flag = MADV_NORMAL;
+    switch (advice) {
+    case ADVICE_NORMAL:
+        flag = MADV_NORMAL;
+        break;
+    case ADVICE_SEQUENTIAL:
+        flag = MADV_SEQUENTIAL;
+        break;
+    case ADVICE_WILLNEED:
+        flag = MADV_WILLNEED;
+        break;
+    case ADVICE_DONTNEED:
+        flag = MADV_DONTNEED;
+        break;
+    }
+    madvise(const_cast<uint8_t*>(_data + begin), static_cast<size_t>(end - begin), flag);
+}
+#endif
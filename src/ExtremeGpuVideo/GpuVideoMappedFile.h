@@ -0,0 +1,51 @@
+//
+//  GpuVideoMappedFile.h
+//
+//  Read-only memory mapping of a .gv file.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+/**
+ * Read-only file mapping shared by every reader of the same file in the process.
+ * Pages come straight from the OS page cache, so nothing is copied at open.
+ */
+class GpuVideoMappedFile {
+public:
+    enum Advice {
+        ADVICE_NORMAL,
+        ADVICE_SEQUENTIAL,
+        ADVICE_WILLNEED,
+        ADVICE_DONTNEED
+    };
+
+    // Returns the existing mapping when the file is already mapped and unchanged on disk.
+    static std::shared_ptr<GpuVideoMappedFile> open(const char* path);
+
+    ~GpuVideoMappedFile();
+
+    GpuVideoMappedFile(const GpuVideoMappedFile&) = delete;
+    void operator=(const GpuVideoMappedFile&) = delete;
+
+    const uint8_t* data() const { return _data; }
+    uint64_t size() const { return _size; }
+
+    // Paging hint for [offset, offset + length). Best effort, never throws.
+    void advise(uint64_t offset, uint64_t length, Advice advice) const;
+private:
+    explicit GpuVideoMappedFile(const std::string& path);
+
+    const uint8_t* _data = nullptr;
+    uint64_t _size = 0;
+#ifdef _MSC_VER
+    void* _file = nullptr;
+    void* _mapping = nullptr;
+#else
+    int _fd = -1;
+#endif
+};
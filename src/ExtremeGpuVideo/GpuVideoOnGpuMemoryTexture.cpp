@@ -9,50 +9,168 @@
 #include "GpuVideoOnGpuMemoryTexture.h"
 
 #include <cassert>
-GpuVideoOnGpuMemoryTexture::GpuVideoOnGpuMemoryTexture(std::shared_ptr<IGpuVideoReader> reader, GLenum interpolation, GLenum wrap) {
-    _textures.resize(reader->getFrameCount());
-    glGenTextures(reader->getFrameCount(), _textures.data());
+#include <climits>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
 
-    GLuint glFmt = 0;
+namespace {
+    // Caps a single allocation (about 256 layers of 1080p DXT5, 16 of 8K) so the driver never needs one huge block.
+    const uint64_t kMaxBytesPerTexture = 512ull * 1024 * 1024;
+}
+
+GpuVideoOnGpuMemoryStorage::GpuVideoOnGpuMemoryStorage(std::shared_ptr<IGpuVideoReader> reader, GLenum interpolation, GLenum wrap, bool incremental)
+    : _reader(reader) {
     switch (reader->getFormat()) {
     case GPU_COMPRESS_DXT1:
-        glFmt = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        _glFmt = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
         break;
     case GPU_COMPRESS_DXT3:
-        glFmt = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+        _glFmt = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
         break;
     case GPU_COMPRESS_DXT5:
-        glFmt = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        _glFmt = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
         break;
 #ifndef __APPLE__
     case GPU_COMPRESS_BC7:
-        glFmt = GL_COMPRESSED_RGBA_BPTC_UNORM_ARB;
+        _glFmt = GL_COMPRESSED_RGBA_BPTC_UNORM_ARB;
         break;
 #endif
     }
-    std::vector<uint8_t> memory(reader->getFrameBytes());
-    for (int i = 0; i < _textures.size(); ++i) {
-        GLuint texture = _textures[i];
 
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, interpolation);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, interpolation);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+    int frameCount = static_cast<int>(reader->getFrameCount());
+    uint64_t frameBytes = reader->getFrameBytes();
+    GLint maxLayers = 0;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+    int layersInBudget = static_cast<int>(std::min<uint64_t>(kMaxBytesPerTexture / std::max<uint64_t>(frameBytes, 1), INT_MAX));
+    _layersPerTexture = std::max(1, std::min(std::min(static_cast<int>(maxLayers), layersInBudget), frameCount));
+    // GL takes image sizes as GLsizei; only a single frame over 2 GB can get past the byte cap.
+    if (static_cast<uint64_t>(INT_MAX) < frameBytes * static_cast<uint64_t>(_layersPerTexture)) {
+        throw std::runtime_error("gv frame too large for a GPU texture");
+    }
+
+    int textureCount = (frameCount + _layersPerTexture - 1) / _layersPerTexture;
+    _textures.resize(textureCount);
+    glGenTextures(textureCount, _textures.data());
+
+    _memory.resize(reader->getFrameBytes());
+    _resident.resize(frameCount, false);
+
+    bool immutable = gpuVideoHasTextureStorage();
+    GLsizei width = reader->getWidth();
+    GLsizei height = reader->getHeight();
+    for (int t = 0; t < textureCount; ++t) {
+        int layers = std::min(_layersPerTexture, frameCount - t * _layersPerTexture);
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, _textures[t]);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, interpolation);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, interpolation);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap);
+        if (immutable) {
+            glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, _glFmt, width, height, layers);
+        }
+        else {
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, 0, _glFmt, width, height, layers, 0, static_cast<GLsizei>(_memory.size() * layers), nullptr);
+        }
+    }
+
+    if (incremental == false) {
+        for (int i = 0; i < frameCount; ++i) {
+            upload(i);
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+GpuVideoOnGpuMemoryStorage::~GpuVideoOnGpuMemoryStorage() {
+    glDeleteTextures(static_cast<GLsizei>(_textures.size()), _textures.data());
+}
+
+void GpuVideoOnGpuMemoryStorage::require(int frame) {
+    if (_resident.empty()) {
+        return;
+    }
+    assert(0 <= frame && frame < static_cast<int>(_resident.size()));
+    if (_resident[frame] == false) {
+        upload(frame);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+}
+void GpuVideoOnGpuMemoryStorage::uploadPending(int from, double milliseconds, uint64_t bytes, int64_t cook) {
+    if (isComplete()) {
+        return;
+    }
+
+    // Every texture sharing the storage calls this each cook; together they get one budget.
+    double spentMs = 0.0;
+    uint64_t uploaded = 0;
+    if (0 <= cook && cook == _cook) {
+        spentMs = _cookMs;
+        uploaded = _cookBytes;
+        if ((bytes != 0 && bytes <= uploaded) || (milliseconds != 0.0 && milliseconds <= spentMs)) {
+            return;
+        }
+    }
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point begin = Clock::now();
 
-        reader->read(memory.data(), i);
-        glCompressedTexImage2D(GL_TEXTURE_2D, 0, glFmt, reader->getWidth(), reader->getHeight(), 0, memory.size(), memory.data());
+    // Playback is usually forward, so fill in from the playhead onwards and wrap.
+    int frameCount = static_cast<int>(_resident.size());
+    int cursor = from;
+    for (int scanned = 0; scanned < frameCount; ++scanned, cursor = (cursor + 1) % frameCount) {
+        if (_resident[cursor]) {
+            continue;
+        }
+        upload(cursor);
+        uploaded += _memory.size();
+
+        if (bytes != 0 && bytes <= uploaded) {
+            break;
+        }
+        if (milliseconds != 0.0 && milliseconds <= spentMs + std::chrono::duration<double, std::milli>(Clock::now() - begin).count()) {
+            break;
+        }
     }
-    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    _cook = cook;
+    _cookMs = spentMs + std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+    _cookBytes = uploaded;
+}
+
+void GpuVideoOnGpuMemoryStorage::upload(int frame) {
+    _reader->read(_memory.data(), frame, &_cursor);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, _textures[frame / _layersPerTexture]);
+    glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, frame % _layersPerTexture, _reader->getWidth(), _reader->getHeight(), 1, _glFmt, static_cast<GLsizei>(_memory.size()), _memory.data());
+
+    _resident[frame] = true;
+    ++_residentCount;
+}
+
+GpuVideoOnGpuMemoryTexture::GpuVideoOnGpuMemoryTexture(std::shared_ptr<IGpuVideoReader> reader, GLenum interpolation, GLenum wrap, bool incremental)
+    : _storage(std::make_shared<GpuVideoOnGpuMemoryStorage>(reader, interpolation, wrap, incremental)) {
 }
-GpuVideoOnGpuMemoryTexture::~GpuVideoOnGpuMemoryTexture() {
-    glDeleteBuffers(_textures.size(), _textures.data());
+GpuVideoOnGpuMemoryTexture::GpuVideoOnGpuMemoryTexture(std::shared_ptr<GpuVideoOnGpuMemoryStorage> storage)
+    : _storage(storage) {
+}
+
+void GpuVideoOnGpuMemoryTexture::setUploadBudget(double milliseconds, uint64_t bytes, int64_t cook) {
+    _budgetMs = milliseconds;
+    _budgetBytes = bytes;
+    _cook = cook;
+}
+float GpuVideoOnGpuMemoryTexture::getUploadProgress() const {
+    int frameCount = _storage->getFrameCount();
+    return frameCount == 0 ? 1.0f : static_cast<float>(_storage->getResidentFrames()) / frameCount;
 }
 
 void GpuVideoOnGpuMemoryTexture::updateCPU(int frame) {
-    assert(0 <= frame && frame < _textures.size());
     _frame = frame;
+    _storage->require(frame);
 }
 void GpuVideoOnGpuMemoryTexture::uploadGPU() {
-    // NOP
-}
\ No newline at end of file
+    _storage->uploadPending(_frame, _budgetMs, _budgetBytes, _cook);
+}
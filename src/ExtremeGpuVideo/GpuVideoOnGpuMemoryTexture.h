@@ -13,29 +13,102 @@
 #include <vector>
 #ifdef _MSC_VER
 #include <gl/glew.h>
-#else
+#elif defined(__APPLE__)
 #include <OpenGL/gl.h>
+#else
+#ifndef GL_GLEXT_PROTOTYPES
+#define GL_GLEXT_PROTOTYPES
+#endif
+#include <GL/gl.h>
+#include <GL/glext.h>
 #endif
 
 
 #include "GpuVideoTexture.h"
 #include "GpuVideoReader.h"
 
+/**
+ * The whole clip as layers of a few GL_TEXTURE_2D_ARRAY chunks.
+ * Holds no playhead, so several textures (e.g. TOP instances playing the same file) can share it.
+ */
+class GpuVideoOnGpuMemoryStorage {
+public:
+    // incremental: only allocate here and upload the frames a budget at a time with uploadPending().
+    GpuVideoOnGpuMemoryStorage(std::shared_ptr<IGpuVideoReader> reader, GLenum interpolation = GL_LINEAR, GLenum wrap = GL_CLAMP_TO_EDGE, bool incremental = false);
+    ~GpuVideoOnGpuMemoryStorage();
+
+    GpuVideoOnGpuMemoryStorage(const GpuVideoOnGpuMemoryStorage&) = delete;
+    void operator=(const GpuVideoOnGpuMemoryStorage&) = delete;
+
+    // Uploads the frame now unless it is resident already.
+    void require(int frame);
+    // Uploads pending frames, nearest ahead of from first, until the budget is spent (0 = unlimited).
+    // Calls passing the same cook (>= 0) share one budget, so textures sharing the storage do not
+    // each spend it; -1 gives the call a budget of its own. The first call of a cook uploads at
+    // least one pending frame regardless of the budget.
+    void uploadPending(int from, double milliseconds, uint64_t bytes, int64_t cook = -1);
+
+    // 0 for a clip without frames
+    GLuint getTexture(int frame) const { return _textures.empty() ? 0 : _textures[frame / _layersPerTexture]; }
+    int getLayer(int frame) const { return frame % _layersPerTexture; }
+    int getFrameCount() const { return static_cast<int>(_resident.size()); }
+    int getResidentFrames() const { return _residentCount; }
+    bool isComplete() const { return _residentCount == static_cast<int>(_resident.size()); }
+    int getTextureCount() const { return static_cast<int>(_textures.size()); }
+    // Allocated up front for every frame, resident or not
+    uint64_t getGpuBytes() const { return static_cast<uint64_t>(_memory.size()) * _resident.size(); }
+private:
+    void upload(int frame);
+
+    std::shared_ptr<IGpuVideoReader> _reader;
+    GpuVideoReadCursor _cursor;
+    GLenum _glFmt = 0;
+    int _layersPerTexture = 1;
+    std::vector<GLuint> _textures;
+
+    std::vector<uint8_t> _memory;
+    std::vector<bool> _resident;
+    int _residentCount = 0;
+
+    // The cook uploadPending() last charged and what it spent
+    int64_t _cook = -1;
+    double _cookMs = 0.0;
+    uint64_t _cookBytes = 0;
+};
+
 /**
  * GPUɂׂă[h
  */
 class GpuVideoOnGpuMemoryTexture : public IGpuVideoTexture {
 public:
-    GpuVideoOnGpuMemoryTexture(std::shared_ptr<IGpuVideoReader> reader, GLenum interpolation = GL_LINEAR, GLenum wrap = GL_CLAMP_TO_EDGE);
-    ~GpuVideoOnGpuMemoryTexture();
+    // incremental: frames are uploaded a budget at a time from uploadGPU().
+    GpuVideoOnGpuMemoryTexture(std::shared_ptr<IGpuVideoReader> reader, GLenum interpolation = GL_LINEAR, GLenum wrap = GL_CLAMP_TO_EDGE, bool incremental = false);
+    // Plays from storage that may be shared with other textures.
+    explicit GpuVideoOnGpuMemoryTexture(std::shared_ptr<GpuVideoOnGpuMemoryStorage> storage);
 
     GpuVideoOnGpuMemoryTexture(const GpuVideoOnGpuMemoryTexture&) = delete;
     void operator=(const GpuVideoOnGpuMemoryTexture&) = delete;
 
+    // A frame that is not resident yet is uploaded on the spot.
     void updateCPU(int frame);
+    // Uploads pending frames, nearest ahead of the playhead first, until the budget is spent.
     void uploadGPU();
-    GLuint getTexture() const { return _textures[_frame]; }
+    GLuint getTexture() const { return _storage->getTexture(_frame); }
+    GLenum getTarget() const { return GL_TEXTURE_2D_ARRAY; }
+    int getLayer() const { return _storage->getLayer(_frame); }
+    float getUploadProgress() const;
+
+    // Shared with every texture on the same storage that passes the same cook.
+    void setUploadBudget(double milliseconds, uint64_t bytes, int64_t cook = -1);
+    int getResidentFrames() const { return _storage->getResidentFrames(); }
+    bool isComplete() const { return _storage->isComplete(); }
+    int getTextureCount() const { return _storage->getTextureCount(); }
+    // The storage's, which other textures may share
+    uint64_t getGpuBytes() const { return _storage->getGpuBytes(); }
 private:
+    std::shared_ptr<GpuVideoOnGpuMemoryStorage> _storage;
     int _frame = 0;
-    std::vector<GLuint> _textures;
-};
\ No newline at end of file
+    double _budgetMs = 4.0;
+    uint64_t _budgetBytes = 0;
+    int64_t _cook = -1;
+};
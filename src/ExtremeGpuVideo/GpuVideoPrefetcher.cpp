@@ -0,0 +1,304 @@
+//
+//  GpuVideoPrefetcher.cpp
+//
+//  Background read-ahead of decoded frames into a ring of frame buffers.
+//
+
+#include "GpuVideoPrefetcher.h"
+
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+// std::min takes it by reference.
+const int GpuVideoPrefetcher::kStepHistory;
+
+GpuVideoPrefetcher::GpuVideoPrefetcher(std::shared_ptr<IGpuVideoReader> reader, uint32_t depth)
+    : _reader(reader)
+    , _depth(depth)
+    , _hits(0)
+    , _misses(0)
+    , _late(0)
+    , _dropped(0) {
+    // depth frames ahead + the frame on screen + one for a synchronous miss
+    _slots.resize(depth + 2);
+    for (Slot& slot : _slots) {
+        slot.owned.resize(reader->getFrameBytes());
+        slot.memory = slot.owned.data();
+    }
+    start();
+}
+GpuVideoPrefetcher::GpuVideoPrefetcher(std::shared_ptr<IGpuVideoReader> reader, uint32_t depth, const std::vector<uint8_t*>& slotMemory)
+    : _reader(reader)
+    , _depth(depth)
+    , _external(true)
+    , _hits(0)
+    , _misses(0)
+    , _late(0)
+    , _dropped(0) {
+    assert(depth + 2 <= slotMemory.size());
+
+    _slots.resize(slotMemory.size());
+    for (size_t i = 0; i < _slots.size(); ++i) {
+        _slots[i].memory = slotMemory[i];
+    }
+    start();
+}
+void GpuVideoPrefetcher::start() {
+    assert(_reader->isThreadSafe());
+
+    _frameCount = static_cast<int>(_reader->getFrameCount());
+    float fps = _reader->getFramePerSecond();
+    _interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / (0.0f < fps ? fps : 30.0f)));
+}
+GpuVideoPrefetcher::~GpuVideoPrefetcher() {
+    // Queued tasks skip their read; completions still write into the slots.
+    std::unique_lock<std::mutex> lock(_mutex);
+    _quit = true;
+    _cond.wait(lock, [this]() { return _inFlight == 0; });
+}
+
+GpuVideoPrefetcher::Lease GpuVideoPrefetcher::acquire(int frame) {
+    assert(0 <= frame && frame < _frameCount);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (0 <= _lastFrame && now - _lastAcquire < std::chrono::seconds(1)) {
+        _interval = _interval - _interval / 8 + (now - _lastAcquire) / 8;
+    }
+    _lastAcquire = now;
+    predict(frame);
+    schedule();
+
+    Lease lease;
+    lease.frame = frame;
+
+    int s = findSlot(frame);
+    if (0 <= s && _slots[s].state == SLOT_DECODING && !_slots[s].started) {
+        // Due now but still queued behind work due later: decode it here, the task will back off.
+        Slot& slot = _slots[s];
+        ++slot.ticket;
+        slot.state = SLOT_LEASED;
+        uint8_t* dst = slot.memory;
+        ++_misses;
+        ++_late;
+        lock.unlock();
+
+        _reader->read(dst, frame, &_cursor);
+
+        lease.slot = s;
+        lease.data = dst;
+        return lease;
+    }
+    if (0 <= s) {
+        // Already in flight: waiting is cheaper than decoding it twice.
+        if (_slots[s].state == SLOT_DECODING) {
+            ++_late;
+            _cond.wait(lock, [&]() { return _slots[s].state != SLOT_DECODING; });
+        }
+        if (_slots[s].state == SLOT_READY && _slots[s].frame == frame) {
+            _slots[s].state = SLOT_LEASED;
+            ++_hits;
+            lease.slot = s;
+            lease.data = _slots[s].memory;
+            lease.hit = true;
+            return lease;
+        }
+    }
+
+    s = findVictim();
+    if (s < 0) {
+        if (_external) {
+            // Caller memory cannot grow; the caller has to release a slot and retry.
+            return lease;
+        }
+        // The caller holds more leases than planned for; grow instead of blocking.
+        _slots.emplace_back();
+        _slots.back().owned.resize(_reader->getFrameBytes());
+        _slots.back().memory = _slots.back().owned.data();
+        s = static_cast<int>(_slots.size()) - 1;
+    }
+    Slot& slot = _slots[s];
+    slot.state = SLOT_LEASED;
+    slot.frame = frame;
+    uint8_t* dst = slot.memory;
+    ++_misses;
+    ++_late;
+    lock.unlock();
+
+    _reader->read(dst, frame, &_cursor);
+
+    lease.slot = s;
+    lease.data = dst;
+    return lease;
+}
+void GpuVideoPrefetcher::release(int slot) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        assert(_slots[slot].state == SLOT_LEASED);
+        // Keep the contents: ping-pong and scrubbing often come back to it.
+        _slots[slot].state = SLOT_READY;
+        schedule();
+    }
+    _cond.notify_all();
+}
+
+float GpuVideoPrefetcher::getStep() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _step;
+}
+uint32_t GpuVideoPrefetcher::getReadyFrames() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint32_t ready = 0;
+    for (int frame : _wanted) {
+        int s = findSlot(frame);
+        if (0 <= s && _slots[s].state == SLOT_READY) {
+            ++ready;
+        }
+    }
+    return ready;
+}
+uint64_t GpuVideoPrefetcher::getResidentBytes() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint64_t bytes = 0;
+    for (const Slot& slot : _slots) {
+        bytes += slot.owned.size();
+    }
+    return bytes;
+}
+
+void GpuVideoPrefetcher::predict(int frame) {
+    if (0 <= _lastFrame && _lastFrame != frame) {
+        int delta = frame - _lastFrame;
+        // Looping playback wraps at the clip end.
+        if (_frameCount / 2 < delta) {
+            delta -= _frameCount;
+        }
+        else if (delta < -_frameCount / 2) {
+            delta += _frameCount;
+        }
+
+        float limit = kStepHistory * std::max(1.0f, std::fabs(_step));
+        if (std::fabs(static_cast<float>(delta)) <= limit) {
+            // Mean of the recent deltas recovers fractional speeds (2, 3, 2, 3 -> 2.5).
+            _deltas[_deltaCount++ % kStepHistory] = delta;
+            int n = std::min(_deltaCount, kStepHistory);
+            int sum = 0;
+            for (int i = 0; i < n; ++i) {
+                sum += _deltas[i];
+            }
+            _step = static_cast<float>(sum) / n;
+        }
+
+        // The playhead is a truncated float; keep its fraction while predictions land.
+        float expected = _position + _step;
+        int expectedFrame = static_cast<int>(std::floor(expected));
+        if (((expectedFrame % _frameCount) + _frameCount) % _frameCount == frame) {
+            _position = expected - static_cast<float>(expectedFrame - frame);
+        }
+        else {
+            _position = static_cast<float>(frame);
+        }
+    }
+    else if (_lastFrame < 0) {
+        _position = static_cast<float>(frame);
+    }
+    _lastFrame = frame;
+
+    _wanted.clear();
+    float at = _position;
+    for (uint32_t i = 0; i < _depth; ++i) {
+        at += _step;
+        int f = static_cast<int>(std::floor(at)) % _frameCount;
+        if (f < 0) {
+            f += _frameCount;
+        }
+        if (f != frame && std::find(_wanted.begin(), _wanted.end(), f) == _wanted.end()) {
+            _wanted.push_back(f);
+        }
+    }
+}
+bool GpuVideoPrefetcher::isWanted(int frame) const {
+    return frame == _lastFrame || std::find(_wanted.begin(), _wanted.end(), frame) != _wanted.end();
+}
+int GpuVideoPrefetcher::findSlot(int frame) const {
+    for (size_t i = 0; i < _slots.size(); ++i) {
+        if (_slots[i].state != SLOT_FREE && _slots[i].frame == frame) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+int GpuVideoPrefetcher::findVictim() const {
+    int victim = -1;
+    for (size_t i = 0; i < _slots.size(); ++i) {
+        const Slot& slot = _slots[i];
+        if (slot.state == SLOT_FREE) {
+            return static_cast<int>(i);
+        }
+        if (slot.state == SLOT_READY && isWanted(slot.frame) == false) {
+            victim = static_cast<int>(i);
+        }
+    }
+    return victim;
+}
+
+void GpuVideoPrefetcher::schedule() {
+    // Nearest wanted frame first, due one acquire() interval after the other.
+    for (size_t i = 0; i < _wanted.size() && !_quit; ++i) {
+        int frame = _wanted[i];
+        if (0 <= findSlot(frame)) {
+            continue;
+        }
+        int s = findVictim();
+        if (s < 0) {
+            return;
+        }
+        Slot& slot = _slots[s];
+        slot.state = SLOT_DECODING;
+        slot.frame = frame;
+        slot.started = false;
+        uint64_t ticket = ++slot.ticket;
+        uint8_t* dst = slot.memory;
+        ++_inFlight;
+        GpuVideoDeadline deadline = _lastAcquire + _interval * static_cast<int>(i + 1);
+
+        // A task even for an asynchronous reader: a synchronous one decodes right there.
+        GpuVideoThreadPool::shared().submit([this, s, ticket, dst, frame, deadline]() {
+            auto done = [this, s]() {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _slots[s].state = SLOT_READY;
+                --_inFlight;
+                // A finished frame that is no longer wanted frees its slot.
+                schedule();
+                // Under the lock: once _inFlight is 0 the destructor may run.
+                _cond.notify_all();
+            };
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                Slot& slot = _slots[s];
+                if (slot.ticket != ticket) {
+                    // acquire() decoded it itself.
+                    --_inFlight;
+                    _cond.notify_all();
+                    return;
+                }
+                // Overtaken by the playhead, or a whole interval overdue: the clock will have moved
+                // past it by the time it is decoded. Not rescheduled until the next acquire().
+                bool overdue = frame != _lastFrame && deadline + _interval < std::chrono::steady_clock::now();
+                if (_quit || !isWanted(frame) || overdue) {
+                    slot.state = SLOT_FREE;
+                    --_inFlight;
+                    if (!_quit) {
+                        ++_dropped;
+                    }
+                    _cond.notify_all();
+                    return;
+                }
+                slot.started = true;
+            }
+            _reader->readAsync(dst, frame, deadline, done, &_cursor);
+        }, deadline);
+    }
+}
@@ -0,0 +1,119 @@
+//
+//  GpuVideoPrefetcher.h
+//
+//  Background read-ahead of decoded frames into a ring of frame buffers.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "GpuVideoReader.h"
+#include "GpuVideoThreadPool.h"
+
+/**
+ * Decodes the frames the playhead is expected to reach next in the background, all of them
+ * in flight at once when the reader has a real readAsync() (GpuVideoReader's fetch engine).
+ * The playback step (direction and speed) is inferred from successive acquire() calls, and
+ * each read runs on the shared GpuVideoThreadPool with the time its frame is expected on screen.
+ * Reads the playhead has overtaken before they started are cancelled, so under load the pool
+ * spends its time on the newest due frame rather than on ones that would be shown late.
+ * The reader must be thread safe.
+ */
+class GpuVideoPrefetcher {
+public:
+    struct Lease {
+        int slot = -1;
+        int frame = -1;
+        const uint8_t* data = nullptr;
+        bool hit = false;
+    };
+
+    // depth: number of frames decoded ahead of the playhead
+    GpuVideoPrefetcher(std::shared_ptr<IGpuVideoReader> reader, uint32_t depth = 4);
+    // Decodes into caller owned buffers (e.g. mapped GPU memory) of getFrameBytes() each.
+    // Needs at least depth + 2 buffers; acquire() returns slot -1 when all of them are leased.
+    GpuVideoPrefetcher(std::shared_ptr<IGpuVideoReader> reader, uint32_t depth, const std::vector<uint8_t*>& slotMemory);
+    ~GpuVideoPrefetcher();
+
+    GpuVideoPrefetcher(const GpuVideoPrefetcher&) = delete;
+    void operator=(const GpuVideoPrefetcher&) = delete;
+
+    // Hands out the decoded frame; decodes synchronously on a miss, or when the frame is still
+    // queued behind other work. The slot belongs to the caller until release().
+    Lease acquire(int frame);
+    void release(int slot);
+
+    uint32_t getDepth() const { return _depth; }
+    // Frames ahead of the playhead that are decoded and waiting, at most getDepth()
+    uint32_t getReadyFrames() const;
+    // Slot buffers the prefetcher allocated itself (none with caller memory)
+    uint64_t getResidentBytes() const;
+    float getStep() const;
+    uint64_t getHits() const { return _hits; }
+    uint64_t getMisses() const { return _misses; }
+    // acquire() calls that had to wait for their frame or decode it themselves
+    uint64_t getLateFrames() const { return _late; }
+    // Read-ahead cancelled before it started: no longer wanted, or past its deadline
+    uint64_t getDroppedFrames() const { return _dropped; }
+private:
+    enum SlotState {
+        SLOT_FREE,
+        SLOT_DECODING,
+        SLOT_READY,
+        SLOT_LEASED
+    };
+    struct Slot {
+        SlotState state = SLOT_FREE;
+        int frame = -1;
+        // Bumped per scheduled read; a task whose ticket is stale was taken over by acquire().
+        uint64_t ticket = 0;
+        // The read left the pool queue.
+        bool started = false;
+        uint8_t* memory = nullptr;
+        std::vector<uint8_t> owned;
+    };
+
+    void start();
+    // Locked. Starts a pool task for every wanted frame that has no slot and can get one.
+    void schedule();
+    void predict(int frame);
+    bool isWanted(int frame) const;
+    int findSlot(int frame) const;
+    int findVictim() const;
+
+    std::shared_ptr<IGpuVideoReader> _reader;
+    // This playhead's place in the reader, which other consumers may share.
+    GpuVideoReadCursor _cursor;
+    uint32_t _depth = 0;
+    int _frameCount = 0;
+    bool _external = false;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _cond;
+    std::vector<Slot> _slots;
+    std::vector<int> _wanted;
+    int _lastFrame = -1;
+    float _position = 0.0f;
+    float _step = 1.0f;
+    static const int kStepHistory = 8;
+    int _deltas[kStepHistory] = {};
+    int _deltaCount = 0;
+    bool _quit = false;
+    // When the last acquire() came and the running mean of the time between them.
+    std::chrono::steady_clock::time_point _lastAcquire;
+    std::chrono::steady_clock::duration _interval;
+
+    std::atomic<uint64_t> _hits;
+    std::atomic<uint64_t> _misses;
+    std::atomic<uint64_t> _late;
+    std::atomic<uint64_t> _dropped;
+    // Reads started by schedule() that have not completed.
+    int _inFlight = 0;
+};
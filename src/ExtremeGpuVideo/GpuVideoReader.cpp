@@ -9,9 +9,28 @@
 #include "GpuVideoReader.h"
 #include <cassert>
 #include <algorithm>
-#include "lz4.h"
+#include <cstring>
+#include "GpuVideoContainer.h"
 
-GpuVideoReader::GpuVideoReader(const char* path, bool onMemory) {
+// Consecutive frames' blocks read at once.
+struct GpuVideoReadSpan {
+    // frames [first, last)
+    int first = 0;
+    int last = 0;
+    // file offset of data
+    uint64_t address = 0;
+    const uint8_t* data = nullptr;
+    uint64_t bytes = 0;
+    std::shared_ptr<GpuVideoAlignedBuffer> buffer;
+    bool ready = false;
+    // readAsync() calls for its frames that arrived while it was being read
+    std::vector<std::function<void()>> waiters;
+};
+
+GpuVideoReader::GpuVideoReader(const char* path, bool onMemory, bool directIO)
+    : _decodeThreads(0)
+    , _coalesceFrames(0)
+    , _coalescedReads(0) {
     _onMemory = onMemory;
 
     _io = std::unique_ptr<GpuVideoIO>(new GpuVideoIO(path, "rb"));
@@ -20,58 +39,297 @@ GpuVideoReader::GpuVideoReader(const char* path, bool onMemory) {
     _rawSize = _io->tellg();
     _io->seek(0, SEEK_SET);
 
-#define R(v) if(_io->read(&v, sizeof(v)) != sizeof(v)) { assert(0); }
-    R(_width);
-    R(_height);
-    R(frame_count_);
-    R(_framePerSecond);
-    R(_format);
-    R(_frameBytes);
-#undef R
-
-    // AhXǂ
-    _lz4Blocks.resize(frame_count_);
-    size_t s = sizeof(Lz4Block);
-
-    _io->seek(_rawSize - sizeof(Lz4Block) * frame_count_, SEEK_SET);
-    if (_io->read(_lz4Blocks.data(), sizeof(Lz4Block) * frame_count_) != sizeof(Lz4Block) * frame_count_) {
-        assert(0);
-    }
+    // v1 or v2, told apart by the magic.
+    GpuVideoIO* io = _io.get();
+    GpuVideoContainer::ReadAt readAt = [io](void* dst, uint64_t size, uint64_t address) {
+        return io->pread(dst, size, address) == size;
+    };
+    GpuVideoContainer container = GpuVideoContainer::parse(readAt, _rawSize);
+    _version = container.version;
+    _width = container.width;
+    _height = container.height;
+    frame_count_ = container.frameCount;
+    _framePerSecond = container.fps;
+    _format = container.format;
+    _frameBytes = container.frameBytes;
+    _lz4Blocks = std::move(container.blocks);
+    const GpuVideoChunk* strips = container.findChunk(GPU_VIDEO_CHUNK_STRIPS);
+    _strips = strips != nullptr
+        ? GpuVideoStrips(container.readChunk(readAt, *strips), _lz4Blocks, _height, _frameBytes)
+        : GpuVideoStrips(_height, _frameBytes);
+    const GpuVideoChunk* checksums = container.findChunk(GPU_VIDEO_CHUNK_CHECKSUMS);
+    _integrity = std::make_shared<GpuVideoIntegrity>(checksums != nullptr ? container.readChunk(readAt, *checksums) : std::vector<uint8_t>(),
+        frame_count_, [this](int frame, std::vector<uint8_t>& buffer) {
+        Lz4Block lz4block = _lz4Blocks[frame];
+        const uint8_t* block = fetch(lz4block.address, lz4block.size);
+        if (block == nullptr) {
+            return false;
+        }
+        buffer.assign(block, block + lz4block.size);
+        return true;
+    });
 
     // KvȂSǂ
     if (_onMemory) {
         _memory.resize(_rawSize);
-        _io->seek(0, SEEK_SET);
-        if (_io->read(_memory.data(), _rawSize) != _rawSize) {
+        if (_io->pread(_memory.data(), _rawSize, 0) != _rawSize) {
             assert(0);
         }
         _io.reset();
     }
     else {
-        _io->seek(kRawMemoryAt, SEEK_SET);
-
-        uint64_t buffer_size = 0;
         for (auto b : _lz4Blocks) {
-            buffer_size = std::max(buffer_size, b.size);
+            _lz4BufferSize = std::max(_lz4BufferSize, b.size);
         }
-
-        _lz4Buffer.resize(buffer_size);
+        if (directIO) {
+            // The header and index went through _io; only frames bypass the cache.
+            _direct = std::unique_ptr<GpuVideoDirectIO>(new GpuVideoDirectIO(path));
+            if (!_direct->isDirect()) {
+                _direct.reset();
+            }
+        }
+        GpuVideoIO* io = _io.get();
+        GpuVideoDirectIO* direct = _direct.get();
+        _source.fd = direct ? direct->descriptor() : io->descriptor();
+        _source.pread = [io, direct](void* dst, std::size_t size, uint64_t offset) {
+            return direct ? direct->pread(dst, size, offset) : io->pread(dst, size, offset);
+        };
+        _source.alignment = direct ? GpuVideoDirectIO::kAlignment : 1;
     }
 }
 GpuVideoReader::~GpuVideoReader() {
+    // Waits for reads still in flight.
+    {
+        std::unique_lock<std::mutex> lock(_readsMutex);
+        _readsDone.wait(lock, [this]() { return _reads == 0; });
+    }
+    _integrity->close();
+}
+void GpuVideoReader::read(uint8_t* dst, int frame, GpuVideoReadCursor* cursor) const {
+    readRows(dst, frame, 0, _height, cursor);
+}
+void GpuVideoReader::readRows(uint8_t* dst, int frame, uint32_t y, uint32_t height, GpuVideoReadCursor* cursor) const {
+    assert(0 <= frame && frame < _lz4Blocks.size());
+    if (_integrity->getStatus(frame) == GpuVideoIntegrity::FRAME_CORRUPT) {
+        memset(dst, 0, _frameBytes);
+        return;
+    }
+    if (!_onMemory && cursor != nullptr && 1 < _coalesceFrames) {
+        std::unique_lock<std::mutex> lock(_spanMutex);
+        bool created = false;
+        std::shared_ptr<GpuVideoReadSpan> span = coalesce(*cursor, frame, created);
+        if (created) {
+            lock.unlock();
+            uint64_t end = _lz4Blocks[span->last - 1].address + _lz4Blocks[span->last - 1].size;
+            uint64_t begin = _direct ? GpuVideoDirectIO::alignDown(span->address) : span->address;
+            uint64_t want = (_direct ? GpuVideoDirectIO::alignUp(end) : end) - begin;
+            span->buffer->reserve(static_cast<size_t>(want));
+            uint64_t got = 0;
+            {
+                GpuVideoStageTimer::Scope timer(_timers.io);
+                got = _direct ? _direct->pread(span->buffer->data(), want, begin) : _io->pread(span->buffer->data(), want, begin);
+            }
+            lock.lock();
+            span->data = span->buffer->data() + (span->address - begin);
+            span->bytes = span->address - begin < got ? got - (span->address - begin) : 0;
+            span->ready = true;
+            std::vector<std::function<void()>> waiters;
+            waiters.swap(span->waiters);
+            lock.unlock();
+            for (const std::function<void()>& waiter : waiters) {
+                waiter();
+            }
+            decodeSpan(*span, dst, frame, y, height);
+            return;
+        }
+        if (span && span->ready) {
+            // The span stays alive while it is sliced, even if the next one replaces it.
+            lock.unlock();
+            decodeSpan(*span, dst, frame, y, height);
+            return;
+        }
+        // Still being read by readAsync(): read this frame on its own rather than wait.
+    }
+
+    Lz4Block lz4block = _lz4Blocks[frame];
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    _strips.compressedRange(frame, lz4block.size, y, height, offset, size);
+    // Checksums cover the whole block, so a frame being verified is read in full.
+    bool hash = _integrity->wantsHash(frame);
+    uint64_t fetchOffset = hash ? 0 : offset;
+    uint64_t fetchSize = hash ? lz4block.size : size;
 
+    const uint8_t* block = fetch(lz4block.address + fetchOffset, fetchSize);
+    decode(dst, frame, y, height, block, block != nullptr ? fetchSize : 0, hash);
 }
-void GpuVideoReader::read(uint8_t* dst, int frame) const {
+void GpuVideoReader::readAsync(uint8_t* dst, int frame, GpuVideoDeadline deadline, const ReadDone& done, GpuVideoReadCursor* cursor) const {
     assert(0 <= frame && frame < _lz4Blocks.size());
+    if (_onMemory || _integrity->getStatus(frame) == GpuVideoIntegrity::FRAME_CORRUPT) {
+        readRows(dst, frame, 0, _height);
+        done();
+        return;
+    }
+    if (cursor != nullptr && 1 < _coalesceFrames) {
+        std::unique_lock<std::mutex> lock(_spanMutex);
+        bool created = false;
+        std::shared_ptr<GpuVideoReadSpan> span = coalesce(*cursor, frame, created);
+        if (span && span->ready) {
+            lock.unlock();
+            decodeSpan(*span, dst, frame, 0, _height);
+            done();
+            return;
+        }
+        if (span) {
+            // Decoded by whichever worker completes the span.
+            span->waiters.push_back([this, span, dst, frame, done]() {
+                decodeSpan(*span, dst, frame, 0, _height);
+                done();
+            });
+            if (created) {
+                lock.unlock();
+                uint64_t end = _lz4Blocks[span->last - 1].address + _lz4Blocks[span->last - 1].size;
+                GpuVideoStageTimer::Clock::time_point submitted = GpuVideoStageTimer::Clock::now();
+                submit(span->address, end - span->address, deadline, span->buffer, [this, span, submitted](const uint8_t* data, uint64_t bytes) {
+                    _timers.io.add(GpuVideoStageTimer::Clock::now() - submitted);
+                    std::vector<std::function<void()>> waiters;
+                    {
+                        std::lock_guard<std::mutex> lock(_spanMutex);
+                        span->data = data;
+                        span->bytes = bytes;
+                        span->ready = true;
+                        waiters.swap(span->waiters);
+                    }
+                    for (const std::function<void()>& waiter : waiters) {
+                        waiter();
+                    }
+                });
+            }
+            return;
+        }
+    }
+
+    // A whole frame is the whole block, whether or not it is hashed.
     Lz4Block lz4block = _lz4Blocks[frame];
+    bool hash = _integrity->wantsHash(frame);
+    GpuVideoStageTimer::Clock::time_point submitted = GpuVideoStageTimer::Clock::now();
+    submit(lz4block.address, lz4block.size, deadline, nullptr, [this, dst, frame, hash, done, submitted](const uint8_t* data, uint64_t bytes) {
+        _timers.io.add(GpuVideoStageTimer::Clock::now() - submitted);
+        decode(dst, frame, 0, _height, data, bytes, hash);
+        done();
+    });
+}
+void GpuVideoReader::decode(uint8_t* dst, int frame, uint32_t y, uint32_t height, const uint8_t* fetched, uint64_t fetchedBytes, bool hash) const {
+    GpuVideoStageTimer::Scope timer(_timers.decode);
+    Lz4Block lz4block = _lz4Blocks[frame];
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    _strips.compressedRange(frame, lz4block.size, y, height, offset, size);
+    uint64_t fetchOffset = hash ? 0 : offset;
+    uint64_t fetchSize = hash ? lz4block.size : size;
+    if (fetched == nullptr || fetchedBytes < fetchSize) {
+        // A failed or short read says nothing about the file (EAGAIN, a network share hiccup):
+        // read it once more, and if that fails too show black this time without marking it corrupt.
+        fetched = fetch(lz4block.address + fetchOffset, fetchSize);
+        if (fetched == nullptr) {
+            _integrity->markReadFailed(frame);
+            memset(dst, 0, _frameBytes);
+            return;
+        }
+    }
+    if ((hash && !_integrity->verify(frame, fetched, fetchSize))
+        || !_strips.decompress(fetched + (offset - fetchOffset), size, frame, y, height, dst, _decodeThreads)) {
+        _integrity->markCorrupt(frame);
+        memset(dst, 0, _frameBytes);
+    }
+}
+std::shared_ptr<GpuVideoReadSpan> GpuVideoReader::coalesce(GpuVideoReadCursor& cursor, int frame, bool& created) const {
+    int last = cursor._lastFrame;
+    cursor._lastFrame = frame;
+    if (cursor._span && cursor._span->first <= frame && frame < cursor._span->last) {
+        return cursor._span;
+    }
+    // Forward: at most one window past the previous read (the prefetcher skips the frame on screen).
+    int window = static_cast<int>(_coalesceFrames);
+    if (last < 0 || frame <= last || last + window < frame) {
+        return nullptr;
+    }
+    std::shared_ptr<GpuVideoReadSpan> span = std::make_shared<GpuVideoReadSpan>();
+    span->first = frame;
+    span->last = spanEnd(frame);
+    span->address = _lz4Blocks[frame].address;
+    span->buffer = std::make_shared<GpuVideoAlignedBuffer>();
+    cursor._span = span;
+    created = true;
+    ++_coalescedReads;
+    return span;
+}
+int GpuVideoReader::spanEnd(int first) const {
+    // Large enough to save syscalls, small enough not to hold a clip's worth of 8K frames.
+    const uint64_t kMaxBytes = 64ull * 1024 * 1024;
+    const uint64_t kMaxGap = GpuVideoDirectIO::kAlignment;
+    int count = static_cast<int>(frame_count_);
+    int last = first + 1;
+    uint64_t end = _lz4Blocks[first].address + _lz4Blocks[first].size;
+    while (last < count && last - first < static_cast<int>(_coalesceFrames)) {
+        const Lz4Block& next = _lz4Blocks[last];
+        // Only blocks stored in order, at most alignment padding apart.
+        if (next.address < end || kMaxGap < next.address - end || kMaxBytes < next.address + next.size - _lz4Blocks[first].address) {
+            break;
+        }
+        end = next.address + next.size;
+        ++last;
+    }
+    return last;
+}
+void GpuVideoReader::decodeSpan(const GpuVideoReadSpan& span, uint8_t* dst, int frame, uint32_t y, uint32_t height) const {
+    Lz4Block lz4block = _lz4Blocks[frame];
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    _strips.compressedRange(frame, lz4block.size, y, height, offset, size);
+    bool hash = _integrity->wantsHash(frame);
+    uint64_t fetchOffset = (hash ? 0 : offset) + (lz4block.address - span.address);
+    uint64_t available = fetchOffset < span.bytes ? span.bytes - fetchOffset : 0;
+    decode(dst, frame, y, height, available != 0 ? span.data + fetchOffset : nullptr, available, hash);
+}
+void GpuVideoReader::submit(uint64_t address, uint64_t size, GpuVideoDeadline deadline, std::shared_ptr<GpuVideoAlignedBuffer> buffer, GpuVideoFetchEngine::Done done) const {
+    {
+        std::lock_guard<std::mutex> lock(_readsMutex);
+        ++_reads;
+    }
+    GpuVideoFetchEngine::shared().submit(_source, address, size, deadline, std::move(buffer), [this, done](const uint8_t* data, uint64_t bytes) {
+        done(data, bytes);
+        // Notified under the lock: once _reads is 0 the destructor may run.
+        std::lock_guard<std::mutex> lock(_readsMutex);
+        if (--_reads == 0) {
+            _readsDone.notify_all();
+        }
+    });
+}
+const uint8_t* GpuVideoReader::fetch(uint64_t address, uint64_t size) const {
     if (_onMemory) {
-        LZ4_decompress_safe((const char*)_memory.data() + lz4block.address, (char*)dst, static_cast<int>(lz4block.size), _frameBytes);
+        return _memory.data() + address;
     }
-    else {
-        _io->seek(lz4block.address, SEEK_SET);
-        if (_io->read(_lz4Buffer.data(), lz4block.size) != lz4block.size) {
-            assert(0);
+    GpuVideoStageTimer::Scope timer(_timers.io);
+    if (_direct) {
+        // Unbuffered reads cover whole aligned pages; the block is somewhere inside.
+        thread_local GpuVideoAlignedBuffer staging;
+        uint64_t begin = GpuVideoDirectIO::alignDown(address);
+        uint64_t end = GpuVideoDirectIO::alignUp(address + size);
+        staging.reserve(static_cast<size_t>(end - begin));
+        // The last page may run past the end of the file.
+        if (_direct->pread(staging.data(), end - begin, begin) < address + size - begin) {
+            return nullptr;
         }
-        LZ4_decompress_safe((const char*)_lz4Buffer.data(), (char*)dst, static_cast<int>(lz4block.size), _frameBytes);
+        return staging.data() + (address - begin);
+    }
+    // Per-thread staging buffer + positional read: no shared cursor, no shared buffer.
+    thread_local std::vector<uint8_t> lz4Buffer;
+    if (lz4Buffer.size() < std::max(_lz4BufferSize, size)) {
+        lz4Buffer.resize(std::max(_lz4BufferSize, size));
     }
-}
\ No newline at end of file
+    if (_io->pread(lz4Buffer.data(), size, address) != size) {
+        return nullptr;
+    }
+    return lz4Buffer.data();
+}
@@ -10,8 +10,37 @@
 #include <cstdlib>
 #include <vector>
 #include <memory>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
 #include "GpuVideo.h"
 #include "GpuVideoIO.h"
+#include "GpuVideoStrips.h"
+#include "GpuVideoIntegrity.h"
+#include "GpuVideoFetchEngine.h"
+#include "GpuVideoThreadPool.h"
+#include "GpuVideoStageTimer.h"
+
+struct GpuVideoReadSpan;
+
+/**
+ * Where one consumer (a prefetcher, a texture) last read a clip. Readers that merge forward reads
+ * keep the merged block here rather than in themselves, so two playheads sharing one reader do
+ * not throw each other's away. Only ever used with one reader; any thread may pass it in.
+ */
+class GpuVideoReadCursor {
+public:
+    GpuVideoReadCursor() {}
+
+    GpuVideoReadCursor(const GpuVideoReadCursor&) = delete;
+    void operator=(const GpuVideoReadCursor&) = delete;
+private:
+    friend class GpuVideoReader;
+    // Guarded by the reader.
+    std::shared_ptr<GpuVideoReadSpan> _span;
+    int _lastFrame = -1;
+};
 
 class IGpuVideoReader 
 {
@@ -27,15 +56,34 @@ public:
 
     virtual bool isThreadSafe() const = 0;
 
+    // Checksums and corrupt frames of the file underneath, if the reader knows them.
+    virtual std::shared_ptr<GpuVideoIntegrity> getIntegrity() const { return nullptr; }
+    // Time spent reading and decompressing frames, for readers that do either on read().
+    virtual const GpuVideoReadTimers* getTimers() const { return nullptr; }
+    // Memory held for the clip: loaded or mapped file, decoded frames.
+    virtual uint64_t getResidentBytes() const { return 0; }
+
     // ǂݍ
-    virtual void read(uint8_t* dst, int frame) const = 0;
+    // cursor: the caller's own, for readers that read ahead of it; null reads just this frame.
+    virtual void read(uint8_t* dst, int frame, GpuVideoReadCursor* cursor = nullptr) const = 0;
+
+    // Called once per readAsync() when dst is filled, possibly on another thread.
+    typedef std::function<void()> ReadDone;
+    // Fills dst like read() in the background; dst must stay valid until done runs.
+    // deadline: when the frame is needed; decodes due sooner run first.
+    // By default it reads synchronously and calls done before returning.
+    virtual void readAsync(uint8_t* dst, int frame, GpuVideoDeadline /* deadline */, const ReadDone& done, GpuVideoReadCursor* cursor = nullptr) const {
+        read(dst, frame, cursor);
+        done();
+    }
 };
 
 
 class GpuVideoReader : public IGpuVideoReader 
 {
 public:
-    GpuVideoReader(const char* path, bool onMemory);
+    // directIO: frames are read unbuffered, bypassing the OS page cache (see GpuVideoDirectIO).
+    GpuVideoReader(const char* path, bool onMemory, bool directIO = false);
     ~GpuVideoReader();
 
     GpuVideoReader(const GpuVideoReader&) = delete;
@@ -47,14 +95,54 @@ public:
     float getFramePerSecond() const { return _framePerSecond; }
     GPU_COMPRESS getFormat() const { return _format; }
     uint32_t getFrameBytes() const { return _frameBytes; }
+    // container version, 1 or 2
+    uint32_t getVersion() const { return _version; }
+    const GpuVideoStrips& getStrips() const { return _strips; }
+    // False when direct I/O was not asked for or the file system does not support it.
+    bool isDirectIO() const { return _direct != nullptr; }
+
+    bool isThreadSafe() const { return true; }
+    std::shared_ptr<GpuVideoIntegrity> getIntegrity() const { return _integrity; }
+    const GpuVideoReadTimers* getTimers() const { return &_timers; }
+    uint64_t getResidentBytes() const { return _memory.size(); }
 
-    bool isThreadSafe() const { return _onMemory; }
+    // Threads the strips of one tiled frame are decompressed on (0 = one per hardware thread)
+    void setDecodeThreads(uint32_t threads) { _decodeThreads = threads; }
+    // "io_uring" or "threads" once readAsync() started the shared fetch engine, "" before.
+    // Its queue depth and backend are process wide, see GpuVideoFetchEngine::configureShared().
+    const char* getFetchBackend() const { return GpuVideoFetchEngine::getSharedBackendName(); }
+    // Forward playback reads the blocks of the next frames (up to this many) in one go and
+    // serves them from that buffer, kept in the caller's cursor; 0 or 1 reads frame by frame.
+    void setCoalesceFrames(uint32_t frames) { _coalesceFrames = frames; }
+    // Merged reads issued so far
+    uint64_t getCoalescedReads() const { return _coalescedReads; }
 
     // ǂݍ
-    void read(uint8_t* dst, int frame) const;
+    void read(uint8_t* dst, int frame, GpuVideoReadCursor* cursor = nullptr) const;
+    // Fills the part of dst (a whole frame) holding pixel rows [y, y + height);
+    // tiled files only read and decompress the strips covering it.
+    void readRows(uint8_t* dst, int frame, uint32_t y, uint32_t height, GpuVideoReadCursor* cursor = nullptr) const;
+    // Queued on the shared GpuVideoFetchEngine and decompressed on the shared pool.
+    void readAsync(uint8_t* dst, int frame, GpuVideoDeadline deadline, const ReadDone& done, GpuVideoReadCursor* cursor = nullptr) const;
 private:
+    // fetched: fetchedBytes of the frame's lz4 block from where readRows() would read it (null on a failed read).
+    void decode(uint8_t* dst, int frame, uint32_t y, uint32_t height, const uint8_t* fetched, uint64_t fetchedBytes, bool hash) const;
+    // Queues a read on the shared engine; the destructor waits until done has returned.
+    void submit(uint64_t address, uint64_t size, GpuVideoDeadline deadline, std::shared_ptr<GpuVideoAlignedBuffer> buffer, GpuVideoFetchEngine::Done done) const;
+
+    // The cursor's span holding frame, or a new one starting at it when playback runs forward.
+    // Locked; null when frame should be read on its own.
+    std::shared_ptr<GpuVideoReadSpan> coalesce(GpuVideoReadCursor& cursor, int frame, bool& created) const;
+    // End (exclusive) of a span starting at first.
+    int spanEnd(int first) const;
+    void decodeSpan(const GpuVideoReadSpan& span, uint8_t* dst, int frame, uint32_t y, uint32_t height) const;
+
+    // size bytes of the file at address, in a per-thread buffer; null on a short read.
+    const uint8_t* fetch(uint64_t address, uint64_t size) const;
+
     bool _onMemory = false;
 
+    uint32_t _version = 1;
     uint32_t _width = 0;
     uint32_t _height = 0;
     uint32_t frame_count_ = 0;
@@ -62,10 +150,26 @@ private:
     GPU_COMPRESS _format = GPU_COMPRESS_DXT1;
     uint32_t _frameBytes = 0;
     std::vector<Lz4Block> _lz4Blocks;
+    GpuVideoStrips _strips;
+    std::atomic<uint32_t> _decodeThreads;
+    std::shared_ptr<GpuVideoIntegrity> _integrity;
 
     std::unique_ptr<GpuVideoIO> _io;
+    std::unique_ptr<GpuVideoDirectIO> _direct;
+    // How the shared fetch engine reads this file
+    GpuVideoFetchEngine::Source _source;
+    mutable std::mutex _readsMutex;
+    mutable std::condition_variable _readsDone;
+    // Reads on the fetch engine that have not completed
+    mutable int _reads = 0;
+
+    std::atomic<uint32_t> _coalesceFrames;
+    // Guards every cursor's span and the spans themselves.
+    mutable std::mutex _spanMutex;
+    mutable std::atomic<uint64_t> _coalescedReads;
+    mutable GpuVideoReadTimers _timers;
     std::vector<uint8_t> _memory;
-    mutable std::vector<uint8_t> _lz4Buffer;
+    uint64_t _lz4BufferSize = 0;
 
     uint64_t _rawSize = 0;
 };
\ No newline at end of file
@@ -0,0 +1,133 @@
+//
+//  GpuVideoReaderCached.cpp
+//
+//  IGpuVideoReader decorator keeping recently decoded frames in memory.
+//
+
+#include "GpuVideoReaderCached.h"
+
+#include <cassert>
+#include <cstring>
+
+GpuVideoReaderCached::GpuVideoReaderCached(std::shared_ptr<IGpuVideoReader> reader, uint64_t budgetBytes)
+    : _reader(reader)
+    , _budgetBytes(budgetBytes)
+    , _hits(0)
+    , _misses(0)
+    , _evictions(0) {
+}
+
+void GpuVideoReaderCached::read(uint8_t* dst, int frame, GpuVideoReadCursor* cursor) const {
+    assert(0 <= frame && frame < static_cast<int>(_reader->getFrameCount()));
+    if (lookup(dst, frame)) {
+        return;
+    }
+    uint32_t failures = readFailures(frame);
+    _reader->read(dst, frame, cursor);
+    store(dst, frame, failures);
+}
+
+void GpuVideoReaderCached::readAsync(uint8_t* dst, int frame, GpuVideoDeadline deadline, const ReadDone& done, GpuVideoReadCursor* cursor) const {
+    assert(0 <= frame && frame < static_cast<int>(_reader->getFrameCount()));
+    if (lookup(dst, frame)) {
+        done();
+        return;
+    }
+    uint32_t failures = readFailures(frame);
+    _reader->readAsync(dst, frame, deadline, [this, dst, frame, failures, done]() {
+        store(dst, frame, failures);
+        done();
+    }, cursor);
+}
+
+bool GpuVideoReaderCached::lookup(uint8_t* dst, int frame) const {
+    Buffer hit;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _index.find(frame);
+        if (it != _index.end()) {
+            _entries.splice(_entries.begin(), _entries, it->second);
+            hit = it->second->data;
+        }
+    }
+    if (hit) {
+        // The shared_ptr keeps the buffer alive even if it is evicted meanwhile.
+        ++_hits;
+        memcpy(dst, hit->data(), _reader->getFrameBytes());
+        return true;
+    }
+    ++_misses;
+    return false;
+}
+
+uint32_t GpuVideoReaderCached::readFailures(int frame) const {
+    std::shared_ptr<GpuVideoIntegrity> integrity = _reader->getIntegrity();
+    return integrity ? integrity->getReadFailures(frame) : 0;
+}
+
+void GpuVideoReaderCached::store(const uint8_t* src, int frame, uint32_t failuresBefore) const {
+    std::shared_ptr<GpuVideoIntegrity> integrity = _reader->getIntegrity();
+    if (integrity && (integrity->getStatus(frame) == GpuVideoIntegrity::FRAME_CORRUPT || integrity->getReadFailures(frame) != failuresBefore)) {
+        return;
+    }
+    uint64_t frameBytes = _reader->getFrameBytes();
+    Buffer buffer;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_budgetBytes < frameBytes || _index.count(frame) != 0) {
+            // Does not fit at all, or another thread cached it first.
+            return;
+        }
+        buffer = evict(frameBytes);
+        if (_budgetBytes < _cachedBytes + frameBytes) {
+            // Other misses reserved the room and their frames are not in the list to evict yet.
+            return;
+        }
+        _cachedBytes += frameBytes;
+    }
+    if (!buffer) {
+        buffer = std::make_shared<std::vector<uint8_t>>(frameBytes);
+    }
+    // Copy outside the lock; the entry is published afterwards.
+    memcpy(buffer->data(), src, frameBytes);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_index.count(frame) != 0) {
+        _cachedBytes -= frameBytes;
+        return;
+    }
+    _entries.push_front(Entry { frame, buffer });
+    _index[frame] = _entries.begin();
+    // The budget may have shrunk meanwhile.
+    evict(0);
+}
+
+void GpuVideoReaderCached::setBudgetBytes(uint64_t budgetBytes) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _budgetBytes = budgetBytes;
+    evict(0);
+}
+uint64_t GpuVideoReaderCached::getBudgetBytes() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _budgetBytes;
+}
+uint64_t GpuVideoReaderCached::getCachedBytes() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _cachedBytes;
+}
+
+GpuVideoReaderCached::Buffer GpuVideoReaderCached::evict(uint64_t extraBytes) const {
+    Buffer reusable;
+    uint64_t frameBytes = _reader->getFrameBytes();
+    while (!_entries.empty() && _budgetBytes < _cachedBytes + extraBytes) {
+        Entry& victim = _entries.back();
+        if (!reusable && victim.data.use_count() == 1) {
+            reusable = victim.data;
+        }
+        _index.erase(victim.frame);
+        _entries.pop_back();
+        _cachedBytes -= frameBytes;
+        ++_evictions;
+    }
+    return reusable;
+}
@@ -0,0 +1,85 @@
+//
+//  GpuVideoReaderCached.h
+//
+//  IGpuVideoReader decorator keeping recently decoded frames in memory.
+//
+
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "GpuVideoReader.h"
+
+/**
+ * Least recently used cache of decoded frames, up to a byte budget.
+ * Sits between no caching and GpuVideoReaderDecompressed: scrubbing and
+ * ping-pong loops stop re-decoding the frames they keep coming back to.
+ * Thread safe when the wrapped reader is.
+ */
+class GpuVideoReaderCached : public IGpuVideoReader {
+public:
+    GpuVideoReaderCached(std::shared_ptr<IGpuVideoReader> reader, uint64_t budgetBytes);
+
+    GpuVideoReaderCached(const GpuVideoReaderCached&) = delete;
+    void operator=(const GpuVideoReaderCached&) = delete;
+
+    uint32_t getWidth() const { return _reader->getWidth(); }
+    uint32_t getHeight() const { return _reader->getHeight(); }
+    uint32_t getFrameCount() const { return _reader->getFrameCount(); }
+    float getFramePerSecond() const { return _reader->getFramePerSecond(); }
+    GPU_COMPRESS getFormat() const { return _reader->getFormat(); }
+    uint32_t getFrameBytes() const { return _reader->getFrameBytes(); }
+
+    bool isThreadSafe() const { return _reader->isThreadSafe(); }
+    std::shared_ptr<GpuVideoIntegrity> getIntegrity() const { return _reader->getIntegrity(); }
+    const GpuVideoReadTimers* getTimers() const { return _reader->getTimers(); }
+    // The wrapped reader's plus the cached frames
+    uint64_t getResidentBytes() const { return _reader->getResidentBytes() + getCachedBytes(); }
+
+    void read(uint8_t* dst, int frame, GpuVideoReadCursor* cursor = nullptr) const;
+    // Hits complete right away; misses go to the wrapped reader's readAsync().
+    void readAsync(uint8_t* dst, int frame, GpuVideoDeadline deadline, const ReadDone& done, GpuVideoReadCursor* cursor = nullptr) const;
+
+    // Shrinking evicts right away.
+    void setBudgetBytes(uint64_t budgetBytes);
+    uint64_t getBudgetBytes() const;
+    uint64_t getCachedBytes() const;
+
+    uint64_t getHits() const { return _hits; }
+    uint64_t getMisses() const { return _misses; }
+    uint64_t getEvictions() const { return _evictions; }
+private:
+    typedef std::shared_ptr<std::vector<uint8_t>> Buffer;
+    struct Entry {
+        int frame;
+        Buffer data;
+    };
+
+    // Copies the cached frame into dst; false on a miss.
+    bool lookup(uint8_t* dst, int frame) const;
+    // Failed reads of frame so far, to compare against once a read completes.
+    uint32_t readFailures(int frame) const;
+    // Caches a copy of src if it fits and was decoded fine: a corrupt frame or a failed read
+    // (readFailures moved on from failuresBefore) leaves black that must not outlive the read.
+    void store(const uint8_t* src, int frame, uint32_t failuresBefore) const;
+    // Drops least recently used frames until extraBytes more fit; returns a reusable buffer if one was freed.
+    Buffer evict(uint64_t extraBytes) const;
+
+    std::shared_ptr<IGpuVideoReader> _reader;
+    uint64_t _budgetBytes = 0;
+
+    mutable std::mutex _mutex;
+    // Front is the most recently used frame.
+    mutable std::list<Entry> _entries;
+    mutable std::unordered_map<int, std::list<Entry>::iterator> _index;
+    mutable uint64_t _cachedBytes = 0;
+
+    mutable std::atomic<uint64_t> _hits;
+    mutable std::atomic<uint64_t> _misses;
+    mutable std::atomic<uint64_t> _evictions;
+};
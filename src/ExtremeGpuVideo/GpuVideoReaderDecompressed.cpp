@@ -7,21 +7,73 @@
 //
 
 #include "GpuVideoReaderDecompressed.h"
+#include "GpuVideoThreadPool.h"
 
-GpuVideoReaderDecompressed::GpuVideoReaderDecompressed(std::shared_ptr<IGpuVideoReader> reader) {
+#include <cstring>
+#include <thread>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+
+GpuVideoReaderDecompressed::GpuVideoReaderDecompressed(std::shared_ptr<IGpuVideoReader> reader, uint32_t threadCount, std::atomic<uint32_t>* decodedFrames, const std::atomic<bool>* cancel) {
     _width = reader->getWidth();
     _height = reader->getHeight();
     frame_count_ = reader->getFrameCount();
     _framePerSecond = reader->getFramePerSecond();
     _format = reader->getFormat();
     _frameBytes = reader->getFrameBytes();
+    _integrity = reader->getIntegrity();
+
+    _decompressed.resize(static_cast<size_t>(frame_count_) * _frameBytes);
 
-    _decompressed.resize(frame_count_ * _frameBytes);
-    for (uint32_t i = 0; i < frame_count_; ++i) {
-        reader->read(_decompressed.data() + i * _frameBytes, i);
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (reader->isThreadSafe() == false) {
+        threadCount = 1;
+    }
+    threadCount = std::min(threadCount, std::max(frame_count_, 1u));
+
+    // Small chunks of frames, one per step, so uneven LZ4 block sizes still balance and
+    // playback work gets a worker between any two of them; each frame decodes straight into its own slot.
+    const uint32_t kChunk = 4;
+    std::atomic<uint32_t> next(0);
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    std::atomic<bool> failed(false);
+    auto step = [&]() {
+        uint32_t begin = next.fetch_add(kChunk);
+        if (frame_count_ <= begin || failed || (cancel && *cancel)) {
+            return false;
+        }
+        try {
+            uint32_t end = std::min(begin + kChunk, frame_count_);
+            for (uint32_t i = begin; i < end; ++i) {
+                reader->read(_decompressed.data() + static_cast<size_t>(i) * _frameBytes, i);
+            }
+            if (decodedFrames) {
+                decodedFrames->fetch_add(end - begin);
+            }
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (failed.exchange(true) == false) {
+                error = std::current_exception();
+            }
+            return false;
+        }
+        return true;
+    };
+
+    GpuVideoThreadPool::shared().parallelSteps(threadCount, gpuVideoBackground(), step);
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    if (cancel && *cancel) {
+        throw std::runtime_error("gv decode cancelled");
     }
 }
 
-void GpuVideoReaderDecompressed::read(uint8_t* dst, int frame) const {
-    memcpy(dst, _decompressed.data() + frame * _frameBytes, _frameBytes);
+void GpuVideoReaderDecompressed::read(uint8_t* dst, int frame, GpuVideoReadCursor*) const {
+    memcpy(dst, _decompressed.data() + static_cast<size_t>(frame) * _frameBytes, _frameBytes);
 }
\ No newline at end of file
@@ -10,10 +10,14 @@
 
 #include "GpuVideoReader.h"
 
+#include <atomic>
 #include <memory>
 class GpuVideoReaderDecompressed : public IGpuVideoReader {
 public:
-    GpuVideoReaderDecompressed(std::shared_ptr<IGpuVideoReader> reader);
+    // threadCount: decode workers, 0 = one per hardware thread (forced to 1 if reader is not thread safe)
+    // decodedFrames: optional counter bumped as frames finish, for load progress
+    // cancel: optional flag; once set, the remaining chunks are skipped and the constructor throws
+    GpuVideoReaderDecompressed(std::shared_ptr<IGpuVideoReader> reader, uint32_t threadCount = 0, std::atomic<uint32_t>* decodedFrames = nullptr, const std::atomic<bool>* cancel = nullptr);
 
     GpuVideoReaderDecompressed(const GpuVideoReaderDecompressed&) = delete;
     void operator=(const GpuVideoReaderDecompressed&) = delete;
@@ -26,8 +30,11 @@ public:
     uint32_t getFrameBytes() const { return _frameBytes; }
 
     bool isThreadSafe() const { return true; }
+    // Whatever decoding everything up front found
+    std::shared_ptr<GpuVideoIntegrity> getIntegrity() const { return _integrity; }
+    uint64_t getResidentBytes() const { return _decompressed.size(); }
 
-    void read(uint8_t* dst, int frame) const;
+    void read(uint8_t* dst, int frame, GpuVideoReadCursor* cursor = nullptr) const;
 private:
     uint32_t _width = 0;
     uint32_t _height = 0;
@@ -37,4 +44,5 @@ private:
     uint32_t _frameBytes = 0;
 
     std::vector<uint8_t> _decompressed;
+    std::shared_ptr<GpuVideoIntegrity> _integrity;
 };
\ No newline at end of file
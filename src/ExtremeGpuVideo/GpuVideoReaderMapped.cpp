@@ -0,0 +1,115 @@
+//
+//  GpuVideoReaderMapped.cpp
+//
+//  IGpuVideoReader decoding LZ4 blocks straight out of a file mapping.
+//
+
+#include "GpuVideoReaderMapped.h"
+
+#include <cassert>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "GpuVideoContainer.h"
+
+GpuVideoReaderMapped::GpuVideoReaderMapped(const char* path, uint32_t readAheadFrames)
+    : _decodeThreads(0)
+    , _readAheadFrames(readAheadFrames)
+    , _hintedUntil(-1) {
+    _file = GpuVideoMappedFile::open(path);
+
+    const uint8_t* head = _file->data();
+    uint64_t rawSize = _file->size();
+    GpuVideoContainer::ReadAt readAt = [head, rawSize](void* dst, uint64_t size, uint64_t address) {
+        if (rawSize < address || rawSize - address < size) {
+            return false;
+        }
+        memcpy(dst, head + address, size);
+        return true;
+    };
+    GpuVideoContainer container = GpuVideoContainer::parse(readAt, rawSize);
+    _version = container.version;
+    _width = container.width;
+    _height = container.height;
+    frame_count_ = container.frameCount;
+    _framePerSecond = container.fps;
+    _format = container.format;
+    _frameBytes = container.frameBytes;
+    _lz4Blocks = std::move(container.blocks);
+    const GpuVideoChunk* strips = container.findChunk(GPU_VIDEO_CHUNK_STRIPS);
+    _strips = strips != nullptr
+        ? GpuVideoStrips(container.readChunk(readAt, *strips), _lz4Blocks, _height, _frameBytes)
+        : GpuVideoStrips(_height, _frameBytes);
+    const GpuVideoChunk* checksums = container.findChunk(GPU_VIDEO_CHUNK_CHECKSUMS);
+    _integrity = std::make_shared<GpuVideoIntegrity>(checksums != nullptr ? container.readChunk(readAt, *checksums) : std::vector<uint8_t>(),
+        frame_count_, [this](int frame, std::vector<uint8_t>& buffer) {
+        Lz4Block lz4block = _lz4Blocks[frame];
+        buffer.assign(_file->data() + lz4block.address, _file->data() + lz4block.address + lz4block.size);
+        return true;
+    });
+
+    // Playback mostly walks forward through the frame blocks.
+    _file->advise(container.dataBegin, container.dataEnd - container.dataBegin, GpuVideoMappedFile::ADVICE_SEQUENTIAL);
+}
+
+GpuVideoReaderMapped::~GpuVideoReaderMapped() {
+    _integrity->close();
+}
+
+void GpuVideoReaderMapped::read(uint8_t* dst, int frame, GpuVideoReadCursor*) const {
+    readRows(dst, frame, 0, _height);
+}
+
+void GpuVideoReaderMapped::readRows(uint8_t* dst, int frame, uint32_t y, uint32_t height) const {
+    assert(0 <= frame && frame < _lz4Blocks.size());
+
+    if (_readAheadFrames != 0) {
+        // Re-hint once the playhead has used up half of the last window, or jumped away from it.
+        int until = _hintedUntil.load(std::memory_order_relaxed);
+        int window = static_cast<int>(_readAheadFrames);
+        if (until < frame + window / 2 || frame + 2 * window < until) {
+            _hintedUntil.store(frame + window, std::memory_order_relaxed);
+            willNeed(frame + 1, window);
+        }
+    }
+
+    if (_integrity->getStatus(frame) == GpuVideoIntegrity::FRAME_CORRUPT) {
+        memset(dst, 0, _frameBytes);
+        return;
+    }
+    GpuVideoStageTimer::Scope timer(_timers.decode);
+    Lz4Block lz4block = _lz4Blocks[frame];
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    _strips.compressedRange(frame, lz4block.size, y, height, offset, size);
+    const uint8_t* block = _file->data() + lz4block.address;
+    if ((_integrity->wantsHash(frame) && !_integrity->verify(frame, block, lz4block.size))
+        || !_strips.decompress(block + offset, size, frame, y, height, dst, _decodeThreads)) {
+        _integrity->markCorrupt(frame);
+        memset(dst, 0, _frameBytes);
+    }
+}
+
+uint64_t GpuVideoReaderMapped::getResidentBytes() const {
+    return _file->size();
+}
+
+void GpuVideoReaderMapped::willNeed(int frame, int count) const {
+    advise(frame, count, GpuVideoMappedFile::ADVICE_WILLNEED);
+}
+void GpuVideoReaderMapped::dontNeed(int frame, int count) const {
+    advise(frame, count, GpuVideoMappedFile::ADVICE_DONTNEED);
+}
+void GpuVideoReaderMapped::advise(int frame, int count, GpuVideoMappedFile::Advice advice) const {
+    int end = std::min(frame + count, static_cast<int>(frame_count_));
+    frame = std::max(frame, 0);
+    if (end <= frame) {
+        return;
+    }
+    // Blocks are stored back to back, so the range is contiguous in the file.
+    uint64_t begin = _lz4Blocks[frame].address;
+    uint64_t last = _lz4Blocks[end - 1].address + _lz4Blocks[end - 1].size;
+    if (begin < last) {
+        _file->advise(begin, last - begin, advice);
+    }
+}
@@ -0,0 +1,77 @@
+//
+//  GpuVideoReaderMapped.h
+//
+//  IGpuVideoReader decoding LZ4 blocks straight out of a file mapping.
+//
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "GpuVideoReader.h"
+#include "GpuVideoMappedFile.h"
+#include "GpuVideoStrips.h"
+
+/**
+ * Replacement for GpuVideoReader(path, true): no private copy of the file,
+ * instances of the same file share page cache pages.
+ */
+class GpuVideoReaderMapped : public IGpuVideoReader {
+public:
+    // readAheadFrames: frames after the playhead to hint as WILLNEED on every read (0 = off)
+    GpuVideoReaderMapped(const char* path, uint32_t readAheadFrames = 8);
+    ~GpuVideoReaderMapped();
+
+    GpuVideoReaderMapped(const GpuVideoReaderMapped&) = delete;
+    void operator=(const GpuVideoReaderMapped&) = delete;
+
+    uint32_t getWidth() const { return _width; }
+    uint32_t getHeight() const { return _height; }
+    uint32_t getFrameCount() const { return frame_count_; }
+    float getFramePerSecond() const { return _framePerSecond; }
+    GPU_COMPRESS getFormat() const { return _format; }
+    uint32_t getFrameBytes() const { return _frameBytes; }
+    // container version, 1 or 2
+    uint32_t getVersion() const { return _version; }
+    const GpuVideoStrips& getStrips() const { return _strips; }
+
+    bool isThreadSafe() const { return true; }
+    std::shared_ptr<GpuVideoIntegrity> getIntegrity() const { return _integrity; }
+    // Page faults on the mapping land in decode; there is no separate read.
+    const GpuVideoReadTimers* getTimers() const { return &_timers; }
+    // The whole mapping, though the OS may have evicted pages of it.
+    uint64_t getResidentBytes() const;
+
+    void read(uint8_t* dst, int frame, GpuVideoReadCursor* cursor = nullptr) const;
+    // Fills the part of dst (a whole frame) holding pixel rows [y, y + height);
+    // tiled files only touch and decompress the strips covering it.
+    void readRows(uint8_t* dst, int frame, uint32_t y, uint32_t height) const;
+
+    // Threads the strips of one tiled frame are decompressed on (0 = one per hardware thread)
+    void setDecodeThreads(uint32_t threads) { _decodeThreads = threads; }
+
+    // Paging hints for the LZ4 blocks of [frame, frame + count)
+    void willNeed(int frame, int count) const;
+    void dontNeed(int frame, int count) const;
+private:
+    void advise(int frame, int count, GpuVideoMappedFile::Advice advice) const;
+
+    uint32_t _version = 1;
+    uint32_t _width = 0;
+    uint32_t _height = 0;
+    uint32_t frame_count_ = 0;
+    float _framePerSecond = 0;
+    GPU_COMPRESS _format = GPU_COMPRESS_DXT1;
+    uint32_t _frameBytes = 0;
+    std::vector<Lz4Block> _lz4Blocks;
+    GpuVideoStrips _strips;
+    std::atomic<uint32_t> _decodeThreads;
+    std::shared_ptr<GpuVideoIntegrity> _integrity;
+
+    std::shared_ptr<GpuVideoMappedFile> _file;
+    mutable GpuVideoReadTimers _timers;
+    uint32_t _readAheadFrames = 0;
+    mutable std::atomic<int> _hintedUntil;
+};
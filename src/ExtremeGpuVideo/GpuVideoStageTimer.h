@@ -0,0 +1,83 @@
+//
+//  GpuVideoStageTimer.h
+//
+//  Running totals of how long one stage of the frame path (read, decompress, upload) takes.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+
+/**
+ * Total time and count of one stage, added to from any thread with two relaxed atomic adds,
+ * so it can stay on in the playback path. Whoever shows the numbers takes the mean over a
+ * window of its choosing with a Window.
+ */
+class GpuVideoStageTimer {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // Adds its own lifetime.
+    class Scope {
+    public:
+        explicit Scope(GpuVideoStageTimer& timer) : _timer(timer), _begin(Clock::now()) {}
+        ~Scope() { _timer.add(Clock::now() - _begin); }
+
+        Scope(const Scope&) = delete;
+        void operator=(const Scope&) = delete;
+    private:
+        GpuVideoStageTimer& _timer;
+        Clock::time_point _begin;
+    };
+
+    // Mean of the samples added between two update() calls.
+    class Window {
+    public:
+        // Milliseconds; the previous mean when nothing was added since.
+        double update(const GpuVideoStageTimer& timer) {
+            uint64_t nanoseconds = timer._nanoseconds.load(std::memory_order_relaxed);
+            uint64_t count = timer._count.load(std::memory_order_relaxed);
+            // A different timer than last time (the clip was reloaded) just restarts the window.
+            if (_count < count && _nanoseconds <= nanoseconds) {
+                _meanMs = static_cast<double>(nanoseconds - _nanoseconds) / static_cast<double>(count - _count) / 1.0e6;
+            }
+            _nanoseconds = nanoseconds;
+            _count = count;
+            return _meanMs;
+        }
+        double getMeanMs() const { return _meanMs; }
+    private:
+        uint64_t _nanoseconds = 0;
+        uint64_t _count = 0;
+        double _meanMs = 0.0;
+    };
+
+    GpuVideoStageTimer() : _nanoseconds(0), _count(0) {}
+
+    GpuVideoStageTimer(const GpuVideoStageTimer&) = delete;
+    void operator=(const GpuVideoStageTimer&) = delete;
+
+    void add(Clock::duration elapsed) {
+        _nanoseconds.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()), std::memory_order_relaxed);
+        _count.fetch_add(1, std::memory_order_relaxed);
+    }
+    void addMilliseconds(double milliseconds) {
+        add(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(milliseconds)));
+    }
+
+    uint64_t getCount() const { return _count.load(std::memory_order_relaxed); }
+    double getTotalMs() const { return static_cast<double>(_nanoseconds.load(std::memory_order_relaxed)) / 1.0e6; }
+private:
+    std::atomic<uint64_t> _nanoseconds;
+    std::atomic<uint64_t> _count;
+};
+
+// What a reader spends per frame.
+struct GpuVideoReadTimers {
+    // Reading the compressed block: a pread, or submit to completion for readAsync()
+    GpuVideoStageTimer io;
+    // LZ4 decompression, plus the checksum when the frame is verified
+    GpuVideoStageTimer decode;
+};
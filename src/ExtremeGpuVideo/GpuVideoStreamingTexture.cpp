@@ -8,7 +8,20 @@
 
 #include "GpuVideoStreamingTexture.h"
 
-GpuVideoStreamingTexture::GpuVideoStreamingTexture(std::shared_ptr<IGpuVideoReader> reader, GLenum interpolation, GLenum wrap) :_reader(reader) {
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    double elapsedMs(Clock::time_point from, Clock::time_point to) {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+}
+
+GpuVideoStreamingTexture::GpuVideoStreamingTexture(std::shared_ptr<IGpuVideoReader> reader, GLenum interpolation, GLenum wrap, uint32_t prefetchDepth, uint32_t pboCount, bool persistent) :_reader(reader) {
 
     glGenTextures(2, _textures);
     for (int i = 0; i < 2; ++i) {
@@ -37,30 +50,274 @@ GpuVideoStreamingTexture::GpuVideoStreamingTexture(std::shared_ptr<IGpuVideoRead
         glBindTexture(GL_TEXTURE_2D, 0);
     }
 
-    _textureMemory.resize(_reader->getFrameBytes());
+    bool usePrefetch = 0 < prefetchDepth && _reader->isThreadSafe();
+
+    // Persistent slots: prefetch ring + frames the GPU may still be reading.
+    uint32_t slotCount = usePrefetch ? prefetchDepth + 2 + std::max(pboCount, 2u) : std::max(pboCount, 2u);
+    if (persistent && setupPersistent(slotCount)) {
+        pboCount = 0;
+    }
+
+    _pbos.resize(pboCount);
+    _fences.resize(pboCount, nullptr);
+    if (0 < pboCount) {
+        glGenBuffers(pboCount, _pbos.data());
+        for (GLuint pbo : _pbos) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, _reader->getFrameBytes(), nullptr, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    if (usePrefetch && _persistentMemory) {
+        std::vector<uint8_t*> slots(slotCount);
+        for (uint32_t i = 0; i < slotCount; ++i) {
+            slots[i] = _persistentMemory + i * _slotStride;
+        }
+        _prefetcher = std::unique_ptr<GpuVideoPrefetcher>(new GpuVideoPrefetcher(_reader, prefetchDepth, slots));
+    }
+    else if (usePrefetch) {
+        _prefetcher = std::unique_ptr<GpuVideoPrefetcher>(new GpuVideoPrefetcher(_reader, prefetchDepth));
+    }
+    else if (_persistentMemory == nullptr) {
+        _textureMemory.resize(_reader->getFrameBytes());
+    }
 }
 GpuVideoStreamingTexture::~GpuVideoStreamingTexture() {
+    if (0 <= _lease.slot) {
+        _prefetcher->release(_lease.slot);
+    }
+    // The worker may be decoding into the persistent mapping; stop it first.
+    _prefetcher.reset();
+
+    for (GLsync fence : _fences) {
+        if (fence) {
+            glDeleteSync(fence);
+        }
+    }
+    if (!_pbos.empty()) {
+        glDeleteBuffers(static_cast<GLsizei>(_pbos.size()), _pbos.data());
+    }
+    for (GLsync fence : _slotFences) {
+        if (fence) {
+            glDeleteSync(fence);
+        }
+    }
+    if (_persistentBuffer) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _persistentBuffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &_persistentBuffer);
+    }
     glDeleteTextures(2, _textures);
 }
+
+// One immutable buffer split into frame slots and mapped for the texture's whole life.
+// CLIENT_STORAGE + READ asks for cached host memory: LZ4 reads back its own output
+// for matches, which would crawl on write-combined memory.
+bool GpuVideoStreamingTexture::setupPersistent(uint32_t slotCount) {
+    if (gpuVideoHasBufferStorage() == false) {
+        return false;
+    }
+
+    _slotStride = (static_cast<GLsizeiptr>(_reader->getFrameBytes()) + 255) & ~static_cast<GLsizeiptr>(255);
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glGenBuffers(1, &_persistentBuffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _persistentBuffer);
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, _slotStride * slotCount, nullptr, flags | GL_CLIENT_STORAGE_BIT);
+    _persistentMemory = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, _slotStride * slotCount, flags));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (_persistentMemory == nullptr) {
+        glDeleteBuffers(1, &_persistentBuffer);
+        _persistentBuffer = 0;
+        return false;
+    }
+    _slotFences.resize(slotCount, nullptr);
+    return true;
+}
+
 void GpuVideoStreamingTexture::updateCPU(int frame) {
     if (_curFrame == frame) {
         return;
     }
     _curFrame = frame;
 
-    _reader->read(_textureMemory.data(), frame);
+    if (_prefetcher) {
+        // Usually a handoff of a buffer the worker already decoded.
+        if (0 <= _lease.slot) {
+            _prefetcher->release(_lease.slot);
+        }
+        if (_persistentMemory) {
+            retireSlots(false);
+            _lease = _prefetcher->acquire(frame);
+            while (_lease.slot < 0 && !_slotsInFlight.empty()) {
+                // Every slot is queued on the GPU; only happens when it falls far behind.
+                retireSlots(true);
+                _lease = _prefetcher->acquire(frame);
+            }
+            if (_lease.slot < 0) {
+                // Every slot is held by read-ahead: keep the previous frame up and retry on the next update.
+                _curFrame = -1;
+                _uploadSlot = -1;
+                _textureNeedsUpload = false;
+                return;
+            }
+            _uploadSlot = _lease.slot;
+        }
+        else {
+            _lease = _prefetcher->acquire(frame);
+        }
+    }
+    else if (_persistentMemory) {
+        int slot = static_cast<int>(_nextSlot);
+        _nextSlot = (_nextSlot + 1) % _slotFences.size();
+        waitSlot(slot);
+        _reader->read(_persistentMemory + slot * _slotStride, frame, &_cursor);
+        _uploadSlot = slot;
+    }
+    else {
+        _reader->read(_textureMemory.data(), frame, &_cursor);
+    }
     _textureNeedsUpload = true;
 }
+
+uint64_t GpuVideoStreamingTexture::getGpuBytes() const {
+    uint64_t frameBytes = _reader->getFrameBytes();
+    return 2 * frameBytes + _pbos.size() * frameBytes + static_cast<uint64_t>(_slotStride) * _slotFences.size();
+}
+
+void GpuVideoStreamingTexture::waitSlot(int slot) {
+    if (_slotFences[slot]) {
+        glClientWaitSync(_slotFences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        glDeleteSync(_slotFences[slot]);
+        _slotFences[slot] = nullptr;
+    }
+}
+
+// Hands persistent slots whose upload has completed back to the prefetcher.
+void GpuVideoStreamingTexture::retireSlots(bool waitOldest) {
+    if (waitOldest && !_slotsInFlight.empty()) {
+        waitSlot(_slotsInFlight.front());
+    }
+    while (!_slotsInFlight.empty()) {
+        int slot = _slotsInFlight.front();
+        if (_slotFences[slot]) {
+            if (glClientWaitSync(_slotFences[slot], 0, 0) == GL_TIMEOUT_EXPIRED) {
+                break;
+            }
+            glDeleteSync(_slotFences[slot]);
+            _slotFences[slot] = nullptr;
+        }
+        _prefetcher->release(slot);
+        _slotsInFlight.pop_front();
+    }
+}
 void GpuVideoStreamingTexture::uploadGPU() {
     if (_textureNeedsUpload == false) {
         return;
     }
+    if (_persistentMemory && _uploadSlot < 0) {
+        // Nothing was decoded into a slot; the previous frame stays.
+        _textureNeedsUpload = false;
+        return;
+    }
 
     std::swap(_textures[0], _textures[1]);
     glBindTexture(GL_TEXTURE_2D, _textures[0]);
 
-    glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0 /* xoffset */, 0 /* yoffset */, _reader->getWidth(), _reader->getHeight(), _glFmt, _reader->getFrameBytes(), _textureMemory.data());
+    GpuVideoUploadTiming timing;
+    timing.frame = _curFrame;
+    timing.bytes = _reader->getFrameBytes();
+    if (_persistentMemory) {
+        uploadFromPersistent(timing);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        _textureNeedsUpload = false;
+        if (_uploadHook) {
+            _uploadHook(timing);
+        }
+        return;
+    }
+
+    const uint8_t* memory = _prefetcher ? _lease.data : _textureMemory.data();
+    if (_pbos.empty() || uploadFromPbo(memory, timing) == false) {
+        Clock::time_point begin = Clock::now();
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0 /* xoffset */, 0 /* yoffset */, _reader->getWidth(), _reader->getHeight(), _glFmt, _reader->getFrameBytes(), memory);
+        timing.submitMs = elapsedMs(begin, Clock::now());
+    }
     glBindTexture(GL_TEXTURE_2D, 0);
 
+    // Both paths have copied the data out, the slot can go back to the ring.
+    if (_prefetcher) {
+        _prefetcher->release(_lease.slot);
+        _lease = GpuVideoPrefetcher::Lease();
+    }
+
     _textureNeedsUpload = false;
+
+    if (_uploadHook) {
+        _uploadHook(timing);
+    }
+}
+
+// Copies the frame into the next PBO of the ring and lets the GPU pull it asynchronously.
+// A slot whose fence has not signaled yet is orphaned rather than waited on.
+bool GpuVideoStreamingTexture::uploadFromPbo(const uint8_t* memory, GpuVideoUploadTiming& timing) {
+    uint32_t i = _pboIndex;
+    _pboIndex = (_pboIndex + 1) % _pbos.size();
+    GLsizeiptr bytes = _reader->getFrameBytes();
+
+    Clock::time_point begin = Clock::now();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pbos[i]);
+    if (_fences[i]) {
+        if (glClientWaitSync(_fences[i], 0, 0) == GL_TIMEOUT_EXPIRED) {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+            timing.orphaned = true;
+        }
+        glDeleteSync(_fences[i]);
+        _fences[i] = nullptr;
+    }
+    Clock::time_point waited = Clock::now();
+
+    // Unsynchronized is safe: the fence has passed or the storage was just orphaned.
+    void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (dst == nullptr) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return false;
+    }
+    memcpy(dst, memory, bytes);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    Clock::time_point copied = Clock::now();
+
+    glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0 /* xoffset */, 0 /* yoffset */, _reader->getWidth(), _reader->getHeight(), _glFmt, static_cast<GLsizei>(bytes), nullptr);
+    _fences[i] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    Clock::time_point submitted = Clock::now();
+
+    timing.usedPbo = true;
+    timing.waitMs = elapsedMs(begin, waited);
+    timing.copyMs = elapsedMs(waited, copied);
+    timing.submitMs = elapsedMs(copied, submitted);
+    return true;
+}
+
+// The frame is already in GPU visible memory: only a buffer to texture copy is queued.
+void GpuVideoStreamingTexture::uploadFromPersistent(GpuVideoUploadTiming& timing) {
+    assert(0 <= _uploadSlot && _uploadSlot < static_cast<int>(_slotFences.size()));
+    Clock::time_point begin = Clock::now();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _persistentBuffer);
+    glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0 /* xoffset */, 0 /* yoffset */, _reader->getWidth(), _reader->getHeight(), _glFmt, _reader->getFrameBytes(), (const void*)(_uploadSlot * _slotStride));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    _slotFences[_uploadSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    if (_prefetcher) {
+        // Stays leased until the fence passes, see retireSlots.
+        _slotsInFlight.push_back(_uploadSlot);
+        _lease = GpuVideoPrefetcher::Lease();
+    }
+    _uploadSlot = -1;
+
+    timing.usedPbo = true;
+    timing.submitMs = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
 }
\ No newline at end of file
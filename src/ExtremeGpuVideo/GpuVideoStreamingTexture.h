@@ -8,21 +8,34 @@
 
 #include <memory>
 #include <array>
+#include <deque>
+#include <vector>
 #ifdef _MSC_VER
 #include <gl/glew.h>
-#else
+#elif defined(__APPLE__)
 #include <OpenGL/gl.h>
+#else
+#ifndef GL_GLEXT_PROTOTYPES
+#define GL_GLEXT_PROTOTYPES
+#endif
+#include <GL/gl.h>
+#include <GL/glext.h>
 #endif
 
 #include "GpuVideoTexture.h"
 #include "GpuVideoReader.h"
+#include "GpuVideoPrefetcher.h"
 
 /**
  * CPUA܂̓Xg[W̃Xg[~Os
  */
 class GpuVideoStreamingTexture : public IGpuVideoTexture {
 public:
-    GpuVideoStreamingTexture(std::shared_ptr<IGpuVideoReader> reader, GLenum interpolation = GL_LINEAR, GLenum wrap = GL_CLAMP_TO_EDGE);
+    // prefetchDepth: frames decoded ahead on a worker thread, 0 = decode synchronously in updateCPU
+    // pboCount: pixel unpack buffers in the upload ring, 0 = upload from client memory
+    // persistent: decode straight into a persistently mapped buffer (zero copy), needs buffer storage;
+    //             falls back to the pbo ring when unavailable
+    GpuVideoStreamingTexture(std::shared_ptr<IGpuVideoReader> reader, GLenum interpolation = GL_LINEAR, GLenum wrap = GL_CLAMP_TO_EDGE, uint32_t prefetchDepth = 4, uint32_t pboCount = 3, bool persistent = false);
     ~GpuVideoStreamingTexture();
 
     GpuVideoStreamingTexture(const GpuVideoStreamingTexture&) = delete;
@@ -33,8 +46,23 @@ public:
     GLuint getTexture() const {
         return _textures[0];
     }
+
+    void setUploadHook(GpuVideoUploadHook hook) { _uploadHook = hook; }
+
+    const GpuVideoPrefetcher* getPrefetcher() const { return _prefetcher.get(); }
+    // Both textures, the pbo ring and the persistent buffer
+    uint64_t getGpuBytes() const;
+    bool isPersistent() const { return _persistentMemory != nullptr; }
 private:
+    bool uploadFromPbo(const uint8_t* memory, GpuVideoUploadTiming& timing);
+    bool setupPersistent(uint32_t slotCount);
+    void uploadFromPersistent(GpuVideoUploadTiming& timing);
+    void waitSlot(int slot);
+    void retireSlots(bool waitOldest);
+
     std::shared_ptr<IGpuVideoReader> _reader;
+    // Used when there is no prefetcher (which keeps its own).
+    GpuVideoReadCursor _cursor;
 
     GLuint _textures[2] = { 0, 0 };
 
@@ -43,4 +71,21 @@ private:
 
     bool _textureNeedsUpload = true;
     std::vector<uint8_t> _textureMemory;
+
+    std::unique_ptr<GpuVideoPrefetcher> _prefetcher;
+    GpuVideoPrefetcher::Lease _lease;
+
+    std::vector<GLuint> _pbos;
+    std::vector<GLsync> _fences;
+    uint32_t _pboIndex = 0;
+
+    GLuint _persistentBuffer = 0;
+    uint8_t* _persistentMemory = nullptr;
+    GLsizeiptr _slotStride = 0;
+    std::vector<GLsync> _slotFences;
+    std::deque<int> _slotsInFlight;
+    int _uploadSlot = -1;
+    uint32_t _nextSlot = 0;
+
+    GpuVideoUploadHook _uploadHook;
 };
\ No newline at end of file
@@ -0,0 +1,137 @@
+//
+//  GpuVideoStrips.cpp
+//
+//  Frames stored as independently LZ4 compressed strips of block rows.
+//
+
+#include "GpuVideoStrips.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#include "lz4.h"
+#include "GpuVideoThreadPool.h"
+
+GpuVideoStrips::GpuVideoStrips(uint32_t height, uint32_t frameBytes)
+    : _rowBytes(height == 0 ? frameBytes : frameBytes / ((height + 3) / 4))
+    , _frameBytes(frameBytes) {
+}
+
+GpuVideoStrips::GpuVideoStrips(const std::vector<uint8_t>& payload, const std::vector<Lz4Block>& blocks, uint32_t height, uint32_t frameBytes)
+    : GpuVideoStrips(height, frameBytes) {
+    uint32_t blockRows = 0;
+    uint32_t strips = 0;
+    if (payload.size() < 8) {
+        throw std::runtime_error("invalid gv strips");
+    }
+    memcpy(&blockRows, payload.data(), 4);
+    memcpy(&strips, payload.data() + 4, 4);
+    if (blockRows == 0 || strips != stripCount(height, blockRows)
+        || payload.size() != 8 + sizeof(uint32_t) * static_cast<uint64_t>(strips) * blocks.size()) {
+        throw std::runtime_error("invalid gv strips");
+    }
+
+    _blockRows = blockRows;
+    _stripCount = strips;
+    _sizes.resize(static_cast<size_t>(strips) * blocks.size());
+    memcpy(_sizes.data(), payload.data() + 8, sizeof(uint32_t) * _sizes.size());
+
+    for (size_t frame = 0; frame < blocks.size(); ++frame) {
+        if (compressedBytes(static_cast<int>(frame), 0, _stripCount) != blocks[frame].size) {
+            throw std::runtime_error("invalid gv strips");
+        }
+    }
+}
+
+uint32_t GpuVideoStrips::stripCount(uint32_t height, uint32_t blockRows) {
+    uint32_t rows = (height + 3) / 4;
+    return blockRows == 0 ? 1 : (rows + blockRows - 1) / blockRows;
+}
+
+void GpuVideoStrips::stripsFor(uint32_t y, uint32_t height, uint32_t& first, uint32_t& last) const {
+    uint32_t rows = _blockRows * 4;
+    first = std::min(y / rows, _stripCount);
+    last = std::min((y + height + rows - 1) / rows, _stripCount);
+}
+
+uint64_t GpuVideoStrips::compressedBytes(int frame, uint32_t first, uint32_t last) const {
+    const uint32_t* sizes = &_sizes[static_cast<size_t>(frame) * _stripCount];
+    uint64_t bytes = 0;
+    for (uint32_t i = first; i < last; ++i) {
+        bytes += sizes[i];
+    }
+    return bytes;
+}
+
+void GpuVideoStrips::compressedRange(int frame, uint64_t blockBytes, uint32_t y, uint32_t height, uint64_t& offset, uint64_t& bytes) const {
+    if (!isTiled()) {
+        offset = 0;
+        bytes = blockBytes;
+        return;
+    }
+    uint32_t first = 0, last = 0;
+    stripsFor(y, height, first, last);
+    offset = compressedBytes(frame, 0, first);
+    bytes = compressedBytes(frame, first, last);
+}
+
+bool GpuVideoStrips::decompress(const uint8_t* src, uint64_t srcBytes, int frame, uint32_t y, uint32_t height, uint8_t* dst, uint32_t threads) const {
+    if (!isTiled()) {
+        // LZ4 can stop early, but only from the top.
+        uint64_t rowsEnd = (static_cast<uint64_t>(y) + height + 3) / 4;
+        int bytes = static_cast<int>(std::min<uint64_t>(_frameBytes, rowsEnd * _rowBytes));
+        int size = bytes == static_cast<int>(_frameBytes)
+            ? LZ4_decompress_safe((const char*)src, (char*)dst, static_cast<int>(srcBytes), bytes)
+            : LZ4_decompress_safe_partial((const char*)src, (char*)dst, static_cast<int>(srcBytes), bytes, static_cast<int>(_frameBytes));
+        return bytes <= size;
+    }
+
+    uint32_t first = 0, last = 0;
+    stripsFor(y, height, first, last);
+    if (last <= first) {
+        return true;
+    }
+    const uint32_t* sizes = &_sizes[static_cast<size_t>(frame) * _stripCount];
+    // Strip offsets within src, so workers can take any strip.
+    std::vector<uint64_t> at(last - first + 1, 0);
+    for (uint32_t i = first; i < last; ++i) {
+        at[i - first + 1] = at[i - first] + sizes[i];
+    }
+    if (srcBytes < at.back()) {
+        return false;
+    }
+
+    uint64_t stripBytes = static_cast<uint64_t>(_blockRows) * _rowBytes;
+    std::atomic<bool> ok(true);
+    auto strip = [&](uint32_t i) {
+        uint64_t begin = i * stripBytes;
+        int bytes = static_cast<int>(std::min<uint64_t>(stripBytes, _frameBytes - begin));
+        int size = LZ4_decompress_safe((const char*)src + at[i - first], (char*)dst + begin, static_cast<int>(sizes[i]), bytes);
+        if (size != bytes) {
+            ok = false;
+        }
+    };
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min(threads, last - first);
+    if (threads <= 1) {
+        for (uint32_t i = first; i < last; ++i) {
+            strip(i);
+        }
+        return ok;
+    }
+
+    std::atomic<uint32_t> next(first);
+    auto work = [&]() {
+        for (uint32_t i = next++; i < last; i = next++) {
+            strip(i);
+        }
+    };
+    GpuVideoThreadPool::shared().parallel(threads, work);
+    return ok;
+}
@@ -0,0 +1,52 @@
+//
+//  GpuVideoStrips.h
+//
+//  Frames stored as independently LZ4 compressed strips of block rows.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "GpuVideo.h"
+
+/**
+ * Layout of the LZ4 data of each frame. In a tiled file (GPU_VIDEO_CHUNK_STRIPS) one frame
+ * decompresses on several threads, and a crop only reads and decompresses the strips it covers.
+ * Strip i holds block rows [i * getBlockRows(), (i + 1) * getBlockRows()).
+ * Untiled frames are one LZ4 block, decompressed from the top as far as a crop needs.
+ */
+class GpuVideoStrips {
+public:
+    GpuVideoStrips() {}
+    // Untiled
+    GpuVideoStrips(uint32_t height, uint32_t frameBytes);
+    // Parses the chunk payload and checks it against the frame index.
+    // Throws std::runtime_error when they disagree.
+    GpuVideoStrips(const std::vector<uint8_t>& payload, const std::vector<Lz4Block>& blocks, uint32_t height, uint32_t frameBytes);
+
+    // Strip count for a frame of height pixels in strips of blockRows block rows.
+    static uint32_t stripCount(uint32_t height, uint32_t blockRows);
+
+    bool isTiled() const { return _blockRows != 0; }
+    uint32_t getBlockRows() const { return _blockRows; }
+    uint32_t getStripCount() const { return _stripCount; }
+
+    // The part of the frame's lz4 block (blockBytes long) holding pixel rows [y, y + height).
+    void compressedRange(int frame, uint64_t blockBytes, uint32_t y, uint32_t height, uint64_t& offset, uint64_t& bytes) const;
+    // src / srcBytes: that part. Fills at least pixel rows [y, y + height) of dst, a whole frame,
+    // with strips spread over up to threads threads (0 = one per hardware thread).
+    // False if the data is corrupt.
+    bool decompress(const uint8_t* src, uint64_t srcBytes, int frame, uint32_t y, uint32_t height, uint8_t* dst, uint32_t threads) const;
+private:
+    void stripsFor(uint32_t y, uint32_t height, uint32_t& first, uint32_t& last) const;
+    uint64_t compressedBytes(int frame, uint32_t first, uint32_t last) const;
+
+    uint32_t _blockRows = 0;
+    uint32_t _stripCount = 1;
+    uint32_t _rowBytes = 0;
+    uint32_t _frameBytes = 0;
+    // [frame * _stripCount + strip]
+    std::vector<uint32_t> _sizes;
+};
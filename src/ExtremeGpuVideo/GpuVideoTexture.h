@@ -9,10 +9,64 @@
 #pragma once
 #ifdef _MSC_VER
 #include <gl/glew.h>
-#else
+#elif defined(__APPLE__)
 #include <OpenGL/gl.h>
+#else
+#ifndef GL_GLEXT_PROTOTYPES
+#define GL_GLEXT_PROTOTYPES
+#endif
+#include <GL/gl.h>
+#include <GL/glext.h>
 #endif
 
+#include <cstdint>
+#include <cstring>
+#include <functional>
+
+class GpuVideoPrefetcher;
+
+inline bool gpuVideoHasGLExtension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && strcmp(extension, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// glBufferStorage: core in 4.4, or GL_ARB_buffer_storage
+inline bool gpuVideoHasBufferStorage() {
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    return 4 < major || (major == 4 && 4 <= minor) || gpuVideoHasGLExtension("GL_ARB_buffer_storage");
+}
+
+// glTexStorage*: core in 4.2, or GL_ARB_texture_storage
+inline bool gpuVideoHasTextureStorage() {
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    return 4 < major || (major == 4 && 2 <= minor) || gpuVideoHasGLExtension("GL_ARB_texture_storage");
+}
+
+/**
+ * One texture upload as seen from the CPU, reported through IGpuVideoTexture::setUploadHook.
+ */
+struct GpuVideoUploadTiming {
+    int frame = -1;
+    uint64_t bytes = 0;
+    double waitMs = 0.0;    // fence check / buffer orphaning before the copy
+    double copyMs = 0.0;    // CPU copy into the staging buffer
+    double submitMs = 0.0;  // glCompressedTexSubImage2D call
+    bool usedPbo = false;
+    bool orphaned = false;  // ring slot was still in use by the GPU
+};
+typedef std::function<void(const GpuVideoUploadTiming&)> GpuVideoUploadHook;
+
 class IGpuVideoTexture {
 public:
     virtual ~IGpuVideoTexture() {}
@@ -20,4 +74,19 @@ public:
     virtual void updateCPU(int frame) = 0;
     virtual void uploadGPU() = 0;
     virtual GLuint getTexture() const = 0;
+    // GL_TEXTURE_2D, or GL_TEXTURE_2D_ARRAY with the current frame in getLayer()
+    virtual GLenum getTarget() const { return GL_TEXTURE_2D; }
+    virtual int getLayer() const { return 0; }
+    // Fraction of the clip resident on the GPU for textures that load it over several cooks.
+    virtual float getUploadProgress() const { return 1.0f; }
+    // Per uploadGPU() call for those textures; 0 means unlimited. cook (e.g. the host's frame
+    // number, -1 for none) lets textures sharing their frames share one budget per cook.
+    virtual void setUploadBudget(double /* milliseconds */, uint64_t /* bytes */, int64_t /* cook */ = -1) {}
+
+    // Instrumentation, called on the GL thread after every upload.
+    virtual void setUploadHook(GpuVideoUploadHook /* hook */) {}
+    // Read-ahead behind updateCPU(), for its counters; null when frames are decoded synchronously.
+    virtual const GpuVideoPrefetcher* getPrefetcher() const { return nullptr; }
+    // Textures and buffers allocated for the clip, as far as GL lets us know
+    virtual uint64_t getGpuBytes() const { return 0; }
 };
\ No newline at end of file
@@ -0,0 +1,268 @@
+//
+//  GpuVideoThreadPool.cpp
+//
+//  One process-wide pool of worker threads, ordered by presentation deadline.
+//
+
+#include "GpuVideoThreadPool.h"
+
+#include <algorithm>
+
+namespace {
+    // Index of the worker running on this thread, -1 elsewhere.
+    thread_local int t_worker = -1;
+    thread_local GpuVideoDeadline t_deadline = GpuVideoDeadline::max();
+
+    std::mutex s_sharedMutex;
+    std::atomic<GpuVideoThreadPool*> s_shared(nullptr);
+}
+
+GpuVideoThreadPool& GpuVideoThreadPool::shared() {
+    GpuVideoThreadPool* pool = s_shared.load(std::memory_order_acquire);
+    if (pool == nullptr) {
+        std::lock_guard<std::mutex> lock(s_sharedMutex);
+        pool = s_shared.load(std::memory_order_relaxed);
+        if (pool == nullptr) {
+            pool = new GpuVideoThreadPool();
+            s_shared.store(pool, std::memory_order_release);
+        }
+    }
+    return *pool;
+}
+
+void GpuVideoThreadPool::shutdownShared() {
+    GpuVideoThreadPool* pool = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(s_sharedMutex);
+        pool = s_shared.exchange(nullptr);
+    }
+    delete pool;
+}
+
+GpuVideoThreadPool::GpuVideoThreadPool(uint32_t threads)
+    : _sequence(0)
+    , _next(0) {
+    if (threads == 0) {
+        threads = std::max(2u, std::thread::hardware_concurrency());
+    }
+    for (uint32_t i = 0; i < threads; ++i) {
+        _queues.emplace_back(new Queue());
+    }
+    for (uint32_t i = 0; i < threads; ++i) {
+        _workers.emplace_back([this, i]() { run(i); });
+    }
+}
+
+GpuVideoThreadPool::~GpuVideoThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _quit = true;
+    }
+    _sleep.notify_all();
+    for (std::thread& w : _workers) {
+        w.join();
+    }
+}
+
+GpuVideoDeadline GpuVideoThreadPool::currentDeadline() {
+    return t_deadline;
+}
+
+namespace {
+    struct Later {
+        template <class E>
+        bool operator()(const E& a, const E& b) const {
+            return a.deadline != b.deadline ? b.deadline < a.deadline : b.sequence < a.sequence;
+        }
+    };
+}
+
+void GpuVideoThreadPool::submit(Task task, GpuVideoDeadline deadline) {
+    // Work spawned by a task goes to its worker's shard, the rest round robin; which shard
+    // only spreads the locking, take() looks at all of them.
+    uint32_t q = 0 <= t_worker && static_cast<size_t>(t_worker) < _queues.size()
+        ? static_cast<uint32_t>(t_worker)
+        : _next++ % static_cast<uint32_t>(_queues.size());
+    // Counted before it is visible, so a worker that takes it never decrements past zero;
+    // one woken in between finds nothing yet and looks again.
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        ++_queued;
+    }
+    {
+        Queue& queue = *_queues[q];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.heap.push_back(Entry { deadline, _sequence++, std::move(task) });
+        std::push_heap(queue.heap.begin(), queue.heap.end(), Later());
+    }
+    _sleep.notify_one();
+}
+
+bool GpuVideoThreadPool::take(uint32_t self, Entry& entry) {
+    // Earliest deadline across all shards; looking at our own first wins ties.
+    size_t n = _queues.size();
+    int best = -1;
+    GpuVideoDeadline bestDeadline;
+    uint64_t bestSequence = 0;
+    for (size_t i = 0; i < n; ++i) {
+        size_t q = (self + i) % n;
+        Queue& queue = *_queues[q];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.heap.empty()) {
+            continue;
+        }
+        const Entry& top = queue.heap.front();
+        if (best < 0 || top.deadline < bestDeadline || (top.deadline == bestDeadline && top.sequence < bestSequence)) {
+            best = static_cast<int>(q);
+            bestDeadline = top.deadline;
+            bestSequence = top.sequence;
+        }
+    }
+    if (best < 0) {
+        return false;
+    }
+    // Another worker may have got there first; then whatever is now on top will do.
+    Queue& queue = *_queues[best];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.heap.empty()) {
+        return false;
+    }
+    std::pop_heap(queue.heap.begin(), queue.heap.end(), Later());
+    entry = std::move(queue.heap.back());
+    queue.heap.pop_back();
+    return true;
+}
+
+void GpuVideoThreadPool::run(uint32_t self) {
+    t_worker = static_cast<int>(self);
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(_sleepMutex);
+            _sleep.wait(lock, [this]() { return _quit || 0 < _queued; });
+            if (_queued == 0) {
+                return;
+            }
+        }
+        Entry entry;
+        if (!take(self, entry)) {
+            std::this_thread::yield();
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(_sleepMutex);
+            --_queued;
+        }
+        t_deadline = entry.deadline;
+        entry.task();
+        t_deadline = GpuVideoDeadline::max();
+    }
+}
+
+uint32_t GpuVideoThreadPool::helpersFor(uint32_t threads, GpuVideoDeadline deadline) const {
+    uint32_t workers = getThreadCount();
+    uint32_t helpers = threads == 0 ? workers : std::min(threads - 1, workers);
+    if (deadline == gpuVideoBackground()) {
+        helpers = std::min(helpers, workers - 1);
+    }
+    return helpers;
+}
+
+void GpuVideoThreadPool::parallel(uint32_t threads, const std::function<void()>& work) {
+    // Someone outside the pool is blocked on this right now.
+    GpuVideoDeadline deadline = 0 <= t_worker ? t_deadline : std::chrono::steady_clock::now();
+    uint32_t helpers = helpersFor(threads, deadline);
+    if (helpers == 0) {
+        work();
+        return;
+    }
+
+    // Helpers that start after the caller is done must not touch work.
+    struct Group {
+        std::mutex mutex;
+        std::condition_variable cond;
+        int running = 0;
+        bool closed = false;
+    };
+    std::shared_ptr<Group> group = std::make_shared<Group>();
+    const std::function<void()>* shared = &work;
+    for (uint32_t i = 0; i < helpers; ++i) {
+        submit([group, shared]() {
+            {
+                std::lock_guard<std::mutex> lock(group->mutex);
+                if (group->closed) {
+                    return;
+                }
+                ++group->running;
+            }
+            (*shared)();
+            std::lock_guard<std::mutex> lock(group->mutex);
+            if (--group->running == 0) {
+                group->cond.notify_all();
+            }
+        }, deadline);
+    }
+
+    work();
+
+    std::unique_lock<std::mutex> lock(group->mutex);
+    group->closed = true;
+    group->cond.wait(lock, [&]() { return group->running == 0; });
+}
+
+namespace {
+    struct StepGroup {
+        std::mutex mutex;
+        std::condition_variable cond;
+        // tasks queued or running
+        int alive = 0;
+        bool closed = false;
+    };
+    // One step, then back into the queue behind anything due sooner.
+    struct StepTask {
+        GpuVideoThreadPool* pool;
+        std::shared_ptr<StepGroup> group;
+        const std::function<bool()>* step;
+        GpuVideoDeadline deadline;
+
+        void operator()() const {
+            {
+                std::lock_guard<std::mutex> lock(group->mutex);
+                if (group->closed) {
+                    if (--group->alive == 0) {
+                        group->cond.notify_all();
+                    }
+                    return;
+                }
+            }
+            bool more = (*step)();
+            std::lock_guard<std::mutex> lock(group->mutex);
+            if (more && !group->closed) {
+                pool->submit(*this, deadline);
+                return;
+            }
+            if (--group->alive == 0) {
+                group->cond.notify_all();
+            }
+        }
+    };
+}
+
+void GpuVideoThreadPool::parallelSteps(uint32_t threads, GpuVideoDeadline deadline, const std::function<bool()>& step) {
+    std::shared_ptr<StepGroup> group = std::make_shared<StepGroup>();
+    uint32_t helpers = helpersFor(threads, deadline);
+    {
+        std::lock_guard<std::mutex> lock(group->mutex);
+        group->alive = static_cast<int>(helpers);
+    }
+    for (uint32_t i = 0; i < helpers; ++i) {
+        submit(StepTask { this, group, &step, deadline }, deadline);
+    }
+
+    while (step()) {
+    }
+
+    // Tasks still queued return without calling step; running ones finish their step.
+    std::unique_lock<std::mutex> lock(group->mutex);
+    group->closed = true;
+    group->cond.wait(lock, [&]() { return group->alive == 0; });
+}
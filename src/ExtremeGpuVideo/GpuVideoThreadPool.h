@@ -0,0 +1,95 @@
+//
+//  GpuVideoThreadPool.h
+//
+//  One process-wide pool of worker threads, ordered by presentation deadline.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// When the result of a task is needed; earlier runs first.
+typedef std::chrono::steady_clock::time_point GpuVideoDeadline;
+
+// Loading, scrubbing: anything nobody is waiting on.
+inline GpuVideoDeadline gpuVideoBackground() { return GpuVideoDeadline::max(); }
+
+/**
+ * Every background job of every player instance (loads, read-ahead, decompression) runs here
+ * instead of on threads of its own, so twenty nodes do not start twenty times the cores.
+ * The queue ordered by deadline is split into one shard per worker to spread the locking;
+ * every take scans all shards for the earliest task, its own first on a tie, so this is one
+ * priority queue rather than work stealing. Tasks must not block on I/O for long, and background
+ * work never holds more than all workers but one, so something due always finds a worker.
+ */
+class GpuVideoThreadPool {
+public:
+    typedef std::function<void()> Task;
+
+    // The instance used by the library, created on first use.
+    static GpuVideoThreadPool& shared();
+    // Runs what is queued on the shared instance and joins its workers; the next shared() starts
+    // a new one. Call it once nothing uses the library any more (the plugin does when its last
+    // node goes away), never from a static destructor: joining threads while a DLL unloads can deadlock.
+    static void shutdownShared();
+
+    // threads: 0 = one per hardware thread, at least 2 so a long load cannot hold up playback
+    explicit GpuVideoThreadPool(uint32_t threads = 0);
+    // Runs what is queued, then joins.
+    ~GpuVideoThreadPool();
+
+    GpuVideoThreadPool(const GpuVideoThreadPool&) = delete;
+    void operator=(const GpuVideoThreadPool&) = delete;
+
+    void submit(Task task, GpuVideoDeadline deadline);
+
+    // Runs work on the calling thread and on up to threads - 1 workers at once (0 = every worker),
+    // returning when all copies that started have returned. work splits the job itself, e.g. with
+    // an atomic counter; copies that start late find nothing left. Helpers inherit the deadline of
+    // the calling task, or "now" when called from outside the pool. For long jobs use parallelSteps().
+    void parallel(uint32_t threads, const std::function<void()>& work);
+
+    // Calls step until it returns false, on the calling thread and on up to threads - 1 workers
+    // (0 = as many as allowed). Each worker runs one step per task and queues the next at deadline,
+    // so a job of any length lets earlier work in between its steps. Returns once every step returned.
+    // The calling thread runs its steps back to back, so call this from outside the pool.
+    void parallelSteps(uint32_t threads, GpuVideoDeadline deadline, const std::function<bool()>& step);
+
+    uint32_t getThreadCount() const { return static_cast<uint32_t>(_workers.size()); }
+    // Deadline of the task running on this thread (gpuVideoBackground() outside the pool).
+    static GpuVideoDeadline currentDeadline();
+private:
+    struct Entry {
+        GpuVideoDeadline deadline;
+        uint64_t sequence;
+        Task task;
+    };
+    struct Queue {
+        std::mutex mutex;
+        // min-heap on (deadline, sequence)
+        std::vector<Entry> heap;
+    };
+
+    bool take(uint32_t self, Entry& entry);
+    void run(uint32_t self);
+    // Workers that work at deadline may occupy at once.
+    uint32_t helpersFor(uint32_t threads, GpuVideoDeadline deadline) const;
+
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread> _workers;
+    std::atomic<uint64_t> _sequence;
+    std::atomic<uint32_t> _next;
+
+    std::mutex _sleepMutex;
+    std::condition_variable _sleep;
+    uint64_t _queued = 0;
+    bool _quit = false;
+};
@@ -0,0 +1,297 @@
+//
+//  GpuVideoWriter.cpp
+//
+//  Writes .gv files, LZ4 compressing frames on several threads.
+//
+
+#include "GpuVideoWriter.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "lz4.h"
+#include "lz4hc.h"
+#include "GpuVideoIO.h"
+#include "GpuVideoStrips.h"
+#include "GpuVideoIntegrity.h"
+
+namespace {
+    // One compressed frame waiting for its turn to be written.
+    struct Pending {
+        bool ready = false;
+        std::vector<uint8_t> data;
+        std::vector<uint32_t> stripSizes;
+        uint64_t checksum = 0;
+    };
+}
+
+GpuVideoWriter::GpuVideoWriter(const char* path, const GpuVideoEncodeSettings& settings)
+    : _path(path)
+    , _settings(settings) {
+    if (settings.width == 0 || settings.height == 0) {
+        throw std::runtime_error("invalid frame size");
+    }
+    if (settings.version != 1 && settings.version != kGpuVideoVersion) {
+        throw std::runtime_error("invalid container version");
+    }
+    if (settings.stripRows != 0 && settings.version == 1) {
+        throw std::runtime_error("strips need container version 2");
+    }
+    if ((settings.blockAlignment & (settings.blockAlignment - 1)) != 0) {
+        throw std::runtime_error("block alignment must be a power of two");
+    }
+    if (settings.level < 0 || LZ4HC_CLEVEL_MAX < settings.level) {
+        throw std::runtime_error("invalid lz4 level");
+    }
+    _frameBytes = frameBytes(settings.width, settings.height, settings.format);
+    if (_frameBytes == 0) {
+        throw std::runtime_error("unsupported format");
+    }
+}
+
+uint32_t GpuVideoWriter::frameBytes(uint32_t width, uint32_t height, GPU_COMPRESS format) {
+    uint32_t blockBytes = 0;
+    switch (format) {
+    case GPU_COMPRESS_DXT1:
+        blockBytes = 8;
+        break;
+    case GPU_COMPRESS_DXT3:
+    case GPU_COMPRESS_DXT5:
+    case GPU_COMPRESS_BC7:
+        blockBytes = 16;
+        break;
+    }
+    return ((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+}
+
+void GpuVideoWriter::encode(uint32_t frameCount, const FrameSource& source, const Progress& progress) {
+    uint32_t threads = _settings.threads != 0 ? _settings.threads : std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, std::max(frameCount, 1u));
+    // Enough frames in flight to keep every worker busy while the writer catches up.
+    uint32_t window = threads * 2;
+
+    GpuVideoIO io(_path.c_str(), "wb");
+    // v2 chunk fields are filled in once the frames are written.
+    writeHeader(io, frameCount, 0, 0);
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::vector<Pending> pending(window);
+    uint32_t next = 0;
+    uint32_t written = 0;
+    bool failed = false;
+    std::exception_ptr error;
+
+    int level = _settings.level;
+    bool checksums = _settings.checksums && _settings.version != 1;
+    // Untiled frames are one strip of every block row.
+    uint32_t blockRows = (_settings.height + 3) / 4;
+    uint32_t stripRows = _settings.stripRows != 0 ? std::min(_settings.stripRows, blockRows) : blockRows;
+    uint32_t strips = GpuVideoStrips::stripCount(_settings.height, stripRows);
+    uint32_t stripBytes = stripRows * (_frameBytes / blockRows);
+    int bound = LZ4_compressBound(static_cast<int>(stripBytes)) * static_cast<int>(strips);
+
+    auto work = [&]() {
+        std::vector<uint8_t> raw(_frameBytes);
+        // lz4 wants its state 8 byte aligned.
+        std::vector<uint64_t> state(((level == 0 ? LZ4_sizeofState() : LZ4_sizeofStateHC()) + 7) / 8);
+        std::vector<uint8_t> compressed(bound);
+        for (;;) {
+            uint32_t frame = 0;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [&]() { return failed || frameCount <= next || next < written + window; });
+                if (failed || frameCount <= next) {
+                    return;
+                }
+                frame = next++;
+            }
+
+            try {
+                source(raw.data(), frame);
+                std::vector<uint32_t> sizes(strips);
+                int total = 0;
+                for (uint32_t i = 0; i < strips; ++i) {
+                    const char* src = (const char*)raw.data() + i * stripBytes;
+                    char* dst = (char*)compressed.data() + total;
+                    int bytes = static_cast<int>(std::min(stripBytes, _frameBytes - i * stripBytes));
+                    int size = level == 0
+                        ? LZ4_compress_fast_extState(state.data(), src, dst, bytes, bound - total, 1)
+                        : LZ4_compress_HC_extStateHC(state.data(), src, dst, bytes, bound - total, level);
+                    if (size <= 0) {
+                        throw std::runtime_error("lz4 compression failed");
+                    }
+                    sizes[i] = static_cast<uint32_t>(size);
+                    total += size;
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                Pending& slot = pending[frame % window];
+                slot.data.assign(compressed.begin(), compressed.begin() + total);
+                slot.stripSizes.swap(sizes);
+                slot.checksum = checksums ? GpuVideoIntegrity::hash(compressed.data(), total) : 0;
+                slot.ready = true;
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!failed) {
+                    failed = true;
+                    error = std::current_exception();
+                }
+            }
+            cond.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (uint32_t t = 0; t < threads; ++t) {
+        workers.emplace_back(work);
+    }
+
+    // This thread writes the blocks in frame order as they come in.
+    std::vector<Lz4Block> blocks(frameCount);
+    std::vector<uint64_t> frameChecksums(checksums ? frameCount : 0);
+    std::vector<uint32_t> stripSizes;
+    if (_settings.stripRows != 0) {
+        stripSizes.reserve(static_cast<size_t>(frameCount) * strips);
+    }
+    uint64_t address = _settings.version == 1 ? kRawMemoryAt : kGpuVideoHeaderBytes;
+    std::vector<uint8_t> data;
+    std::vector<uint8_t> padding(_settings.blockAlignment);
+    try {
+        while (written < frameCount) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [&]() { return failed || pending[written % window].ready; });
+                if (failed) {
+                    break;
+                }
+                Pending& slot = pending[written % window];
+                data.swap(slot.data);
+                if (_settings.stripRows != 0) {
+                    stripSizes.insert(stripSizes.end(), slot.stripSizes.begin(), slot.stripSizes.end());
+                }
+                if (checksums) {
+                    frameChecksums[written] = slot.checksum;
+                }
+                slot.ready = false;
+            }
+
+            uint64_t pad = _settings.blockAlignment == 0 ? 0 : (_settings.blockAlignment - address % _settings.blockAlignment) % _settings.blockAlignment;
+            // With no alignment padding is empty and its data() may be null.
+            if ((pad != 0 && io.write(padding.data(), pad) != pad) || io.write(data.data(), data.size()) != data.size()) {
+                throw std::runtime_error("write failed");
+            }
+            address += pad;
+            blocks[written].address = address;
+            blocks[written].size = data.size();
+            address += data.size();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++written;
+            }
+            cond.notify_all();
+            if (progress) {
+                progress(written);
+            }
+        }
+    }
+    catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!failed) {
+            failed = true;
+            error = std::current_exception();
+        }
+    }
+    cond.notify_all();
+    for (std::thread& w : workers) {
+        w.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    size_t indexBytes = sizeof(Lz4Block) * blocks.size();
+    if (io.write(blocks.data(), indexBytes) != indexBytes) {
+        throw std::runtime_error("write failed");
+    }
+    if (_settings.version == 1) {
+        _fileBytes = address + indexBytes;
+        return;
+    }
+
+    std::vector<GpuVideoChunk> chunks(1);
+    chunks[0].id = GPU_VIDEO_CHUNK_INDEX;
+    chunks[0].flags = GPU_VIDEO_CHUNK_REQUIRED;
+    chunks[0].address = address;
+    chunks[0].size = indexBytes;
+    address += indexBytes;
+
+    if (_settings.stripRows != 0) {
+        // Older readers would take a run of strips for one LZ4 block.
+        GpuVideoChunk chunk;
+        chunk.id = GPU_VIDEO_CHUNK_STRIPS;
+        chunk.flags = GPU_VIDEO_CHUNK_REQUIRED;
+        chunk.address = address;
+        chunk.size = 8 + sizeof(uint32_t) * stripSizes.size();
+        if (io.write(&stripRows, 4) != 4 || io.write(&strips, 4) != 4
+            || io.write(stripSizes.data(), sizeof(uint32_t) * stripSizes.size()) != sizeof(uint32_t) * stripSizes.size()) {
+            throw std::runtime_error("write failed");
+        }
+        chunks.push_back(chunk);
+        address += chunk.size;
+    }
+
+    if (checksums) {
+        // Optional: readers without verification just skip it.
+        GpuVideoChunk chunk;
+        chunk.id = GPU_VIDEO_CHUNK_CHECKSUMS;
+        chunk.address = address;
+        chunk.size = sizeof(uint64_t) * frameChecksums.size();
+        if (io.write(frameChecksums.data(), chunk.size) != chunk.size) {
+            throw std::runtime_error("write failed");
+        }
+        chunks.push_back(chunk);
+        address += chunk.size;
+    }
+
+    size_t tableBytes = sizeof(GpuVideoChunk) * chunks.size();
+    if (io.write(chunks.data(), tableBytes) != tableBytes) {
+        throw std::runtime_error("write failed");
+    }
+    _fileBytes = address + tableBytes;
+    if (io.seek(0, SEEK_SET) != 0) {
+        throw std::runtime_error("write failed");
+    }
+    writeHeader(io, frameCount, static_cast<uint32_t>(chunks.size()), address);
+}
+
+void GpuVideoWriter::writeHeader(GpuVideoIO& io, uint32_t frameCount, uint32_t chunkCount, uint64_t chunkTableAt) const {
+#define W(v) if(io.write(&v, sizeof(v)) != sizeof(v)) { throw std::runtime_error("write failed"); }
+    uint32_t fmt = _settings.format;
+    if (_settings.version != 1) {
+        uint32_t magic = kGpuVideoMagic;
+        uint32_t version = kGpuVideoVersion;
+        uint32_t headerBytes = kGpuVideoHeaderBytes;
+        W(magic);
+        W(version);
+        W(headerBytes);
+    }
+    W(_settings.width);
+    W(_settings.height);
+    W(frameCount);
+    W(_settings.fps);
+    W(fmt);
+    W(_frameBytes);
+    if (_settings.version != 1) {
+        W(chunkCount);
+        W(chunkTableAt);
+    }
+#undef W
+}
@@ -0,0 +1,69 @@
+//
+//  GpuVideoWriter.h
+//
+//  Writes .gv files, LZ4 compressing frames on several threads.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "GpuVideo.h"
+
+class GpuVideoIO;
+
+struct GpuVideoEncodeSettings {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    float fps = 30.0f;
+    GPU_COMPRESS format = GPU_COMPRESS_DXT5;
+    // 0 = LZ4 (fastest), 1..12 = LZ4HC level (smaller files, same decode speed)
+    int level = 9;
+    // 0 = one per hardware thread
+    uint32_t threads = 0;
+    // container version: 2, or 1 for players that predate it
+    uint32_t version = kGpuVideoVersion;
+    // Block rows per independently compressed strip (0 = one LZ4 block per frame). Needs version 2.
+    uint32_t stripRows = 0;
+    // XXH64 of every frame's LZ4 data, for GpuVideoIntegrity. Version 2 only.
+    bool checksums = true;
+    // Each frame's LZ4 block starts on a multiple of this many bytes, zero padded (0 = packed).
+    // 4096 lets unbuffered readers fetch a frame without touching its neighbours. Power of two.
+    uint32_t blockAlignment = 0;
+};
+
+/**
+ * Produces the GpuVideo.h layout: header, one LZ4 block per frame, Lz4Block index
+ * (v1 at the end of the file, v2 as a chunk followed by the chunk table).
+ * Frames are fetched and compressed out of order on worker threads and written in order,
+ * with a bounded number of frames in flight.
+ */
+class GpuVideoWriter {
+public:
+    // Fills dst (getFrameBytes()) with the BCn payload of the frame. Called from worker threads.
+    typedef std::function<void(uint8_t* dst, uint32_t frame)> FrameSource;
+    // Frames written so far, called on the calling thread.
+    typedef std::function<void(uint32_t written)> Progress;
+
+    GpuVideoWriter(const char* path, const GpuVideoEncodeSettings& settings);
+
+    GpuVideoWriter(const GpuVideoWriter&) = delete;
+    void operator=(const GpuVideoWriter&) = delete;
+
+    static uint32_t frameBytes(uint32_t width, uint32_t height, GPU_COMPRESS format);
+    uint32_t getFrameBytes() const { return _frameBytes; }
+
+    // Writes the whole file. Exceptions from source or from the file are rethrown here.
+    void encode(uint32_t frameCount, const FrameSource& source, const Progress& progress = Progress());
+
+    uint64_t getFileBytes() const { return _fileBytes; }
+private:
+    void writeHeader(GpuVideoIO& io, uint32_t frameCount, uint32_t chunkCount, uint64_t chunkTableAt) const;
+
+    std::string _path;
+    GpuVideoEncodeSettings _settings;
+    uint32_t _frameBytes = 0;
+    uint64_t _fileBytes = 0;
+};
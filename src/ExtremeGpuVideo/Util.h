@@ -15,6 +15,27 @@ enum Mode
 	GPU_VIDEO_ON_GPU_MEMORY
 };
 
+enum LoadState
+{
+	/* nothing requested */
+	LOAD_IDLE,
+
+	/* background: opening file and reading the index */
+	LOAD_OPENING,
+
+	/* background: pre decompressing frames */
+	LOAD_DECODING,
+
+	/* cook thread: creating textures */
+	LOAD_UPLOADING,
+
+	/* swapped in and playing */
+	LOAD_READY,
+
+	/* open or decode threw */
+	LOAD_FAILED
+};
+
 static const char* vertexShader = "#version 330\n\
 layout(location = 0) in vec3 position; \
 layout(location = 1) in vec2 texcoord; \
@@ -33,5 +54,16 @@ void main() { \
     finalColor = color; \
 }";
 
+/* On GPU Memory: frames are layers of a texture array */
+static const char* fragmentShaderArray = "#version 330\n\
+uniform sampler2DArray u_src; \
+uniform int u_layer; \
+in vec2 v_texcoord; \
+out vec4 finalColor; \
+void main() { \
+    vec4 color = texture(u_src, vec3(v_texcoord, float(u_layer))); \
+    finalColor = color; \
+}";
+
 static const char* uniformError = "A uniform location could not be found.";
 
@@ -0,0 +1,92 @@
+//
+//  DdsFile.h
+//
+//  Minimal reader for the block compressed DDS files the encoder accepts.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "GpuVideo.h"
+#include "GpuVideoIO.h"
+
+struct DdsInfo {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    GPU_COMPRESS format = GPU_COMPRESS_DXT1;
+    // Offset of the top mip level payload
+    uint32_t dataAt = 0;
+};
+
+// Reads the header of a DXT1/3/5 (FourCC) or BC1/2/3/7 (DX10 header) file.
+inline DdsInfo readDdsInfo(GpuVideoIO& io, const std::string& path) {
+    uint8_t header[148] = {};
+    size_t size = io.pread(header, sizeof(header), 0);
+    if (size < 128 || memcmp(header, "DDS ", 4) != 0) {
+        throw std::runtime_error(path + ": not a dds file");
+    }
+
+    DdsInfo info;
+    memcpy(&info.height, header + 12, 4);
+    memcpy(&info.width, header + 16, 4);
+    info.dataAt = 128;
+
+    char fourCC[4];
+    memcpy(fourCC, header + 84, 4);
+    if (memcmp(fourCC, "DXT1", 4) == 0) {
+        info.format = GPU_COMPRESS_DXT1;
+    }
+    else if (memcmp(fourCC, "DXT3", 4) == 0) {
+        info.format = GPU_COMPRESS_DXT3;
+    }
+    else if (memcmp(fourCC, "DXT5", 4) == 0) {
+        info.format = GPU_COMPRESS_DXT5;
+    }
+    else if (memcmp(fourCC, "DX10", 4) == 0 && size == sizeof(header)) {
+        uint32_t dxgiFormat = 0;
+        memcpy(&dxgiFormat, header + 128, 4);
+        info.dataAt = 148;
+        switch (dxgiFormat) {
+        case 71: case 72:   // BC1_UNORM(_SRGB)
+            info.format = GPU_COMPRESS_DXT1;
+            break;
+        case 74: case 75:   // BC2_UNORM(_SRGB)
+            info.format = GPU_COMPRESS_DXT3;
+            break;
+        case 77: case 78:   // BC3_UNORM(_SRGB)
+            info.format = GPU_COMPRESS_DXT5;
+            break;
+        case 98: case 99:   // BC7_UNORM(_SRGB)
+            info.format = GPU_COMPRESS_BC7;
+            break;
+        default:
+            throw std::runtime_error(path + ": unsupported dxgi format " + std::to_string(dxgiFormat));
+        }
+    }
+    else {
+        throw std::runtime_error(path + ": unsupported dds pixel format");
+    }
+    return info;
+}
+
+inline DdsInfo readDdsInfo(const std::string& path) {
+    GpuVideoIO io(path.c_str(), "rb");
+    return readDdsInfo(io, path);
+}
+
+// Copies the top mip level (frameBytes) of a file matching expected into dst.
+inline void readDdsFrame(const std::string& path, const DdsInfo& expected, uint8_t* dst, uint32_t frameBytes) {
+    GpuVideoIO io(path.c_str(), "rb");
+    DdsInfo info = readDdsInfo(io, path);
+    if (info.width != expected.width || info.height != expected.height || info.format != expected.format) {
+        throw std::runtime_error(path + ": size or format differs from the first frame");
+    }
+    if (io.pread(dst, frameBytes, info.dataAt) != frameBytes) {
+        throw std::runtime_error(path + ": truncated");
+    }
+}
@@ -0,0 +1,249 @@
+//
+//  GpuVideoEncoder.cpp
+//
+//  Command line .gv encoder: DDS image sequence or raw BCn frames in, or
+//  PPM / PAM / raw RGBA frames block compressed to DXT1 / DXT5 on the way,
+//  LZ4 / LZ4HC compressed .gv out, frames compressed in parallel.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <functional>
+
+#include "GpuVideo.h"
+#include "GpuVideoIO.h"
+#include "GpuVideoWriter.h"
+#include "GpuVideoBlockEncoder.h"
+#include "DdsFile.h"
+#include "NetpbmFile.h"
+
+namespace {
+    struct EncoderOptions {
+        std::string output;
+        std::vector<std::string> inputs;    // DDS or PPM / PAM files, one per frame, in order
+        std::string raw;                    // or one file of back to back BCn frames
+        std::string rawRgba;                // or one file of back to back RGBA8 frames
+        GpuVideoEncodeSettings settings;
+        GpuVideoBlockEncoder::Quality quality = GpuVideoBlockEncoder::QUALITY_NORMAL;
+        bool quiet = false;
+    };
+
+    void usage(const char* exe) {
+        std::printf(
+            "usage: %s -o OUT.gv [--fps F] [--level 0-12] [--threads N] [--quiet] FRAME.dds...\n"
+            "       %s -o OUT.gv --raw FRAMES.bin --width N --height N --format 1|3|5|7 [--fps F] [--level 0-12] [--threads N]\n"
+            "       %s -o OUT.gv [--format 1|5] [--quality fast|normal|high] [--fps F] [--level 0-12] [--threads N] FRAME.ppm|FRAME.pam...\n"
+            "       %s -o OUT.gv --raw-rgba FRAMES.rgba --width N --height N [--format 1|5] [--quality fast|normal|high] [...]\n"
+            "  --level 0 is LZ4, 1-12 are LZ4HC levels (default 9)\n"
+            "  --threads 0 uses one thread per core (default)\n"
+            "  --container 1 writes the original header for players without v2 support (default 2)\n"
+            "  --no-checksums leaves out the per-frame XXH64 checksums of v2 files\n"
+            "  --align N starts every frame on a multiple of N bytes, e.g. 4096 for direct I/O playback (default 0, packed)\n"
+            "  --strip-rows N compresses every N block rows on their own, for parallel and cropped decode (default 0, off)\n"
+            "  RGBA input is block compressed to --format (default 5, DXT5) at --quality (default normal)\n", exe, exe, exe, exe);
+    }
+
+    bool parseOptions(int argc, char** argv, EncoderOptions& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--quiet") {
+                options.quiet = true;
+            }
+            else if ((arg == "-o" || arg == "--output") && hasValue) {
+                options.output = argv[++i];
+            }
+            else if (arg == "--raw" && hasValue) {
+                options.raw = argv[++i];
+            }
+            else if (arg == "--raw-rgba" && hasValue) {
+                options.rawRgba = argv[++i];
+            }
+            else if (arg == "--quality" && hasValue) {
+                std::string quality = argv[++i];
+                if (quality == "fast") {
+                    options.quality = GpuVideoBlockEncoder::QUALITY_FAST;
+                }
+                else if (quality == "normal") {
+                    options.quality = GpuVideoBlockEncoder::QUALITY_NORMAL;
+                }
+                else if (quality == "high") {
+                    options.quality = GpuVideoBlockEncoder::QUALITY_HIGH;
+                }
+                else {
+                    return false;
+                }
+            }
+            else if (arg == "--width" && hasValue) {
+                options.settings.width = static_cast<uint32_t>(std::atoi(argv[++i]));
+            }
+            else if (arg == "--height" && hasValue) {
+                options.settings.height = static_cast<uint32_t>(std::atoi(argv[++i]));
+            }
+            else if (arg == "--format" && hasValue) {
+                options.settings.format = static_cast<GPU_COMPRESS>(std::atoi(argv[++i]));
+            }
+            else if (arg == "--fps" && hasValue) {
+                options.settings.fps = static_cast<float>(std::atof(argv[++i]));
+            }
+            else if (arg == "--level" && hasValue) {
+                options.settings.level = std::atoi(argv[++i]);
+            }
+            else if (arg == "--threads" && hasValue) {
+                options.settings.threads = static_cast<uint32_t>(std::atoi(argv[++i]));
+            }
+            else if (arg == "--container" && hasValue) {
+                options.settings.version = static_cast<uint32_t>(std::atoi(argv[++i]));
+            }
+            else if (arg == "--no-checksums") {
+                options.settings.checksums = false;
+            }
+            else if (arg == "--align" && hasValue) {
+                options.settings.blockAlignment = static_cast<uint32_t>(std::atoi(argv[++i]));
+            }
+            else if (arg == "--strip-rows" && hasValue) {
+                options.settings.stripRows = static_cast<uint32_t>(std::atoi(argv[++i]));
+            }
+            else if (arg.size() > 1 && arg[0] == '-') {
+                return false;
+            }
+            else {
+                options.inputs.push_back(arg);
+            }
+        }
+        if (options.output.empty() || options.settings.fps <= 0.0f) {
+            return false;
+        }
+        // Exactly one of the three input kinds.
+        return int(!options.inputs.empty()) + int(!options.raw.empty()) + int(!options.rawRgba.empty()) == 1;
+    }
+}
+
+int main(int argc, char** argv) {
+    EncoderOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    bool started = false;
+    try {
+        uint32_t frameCount = 0;
+        GpuVideoWriter::FrameSource source;
+        std::unique_ptr<GpuVideoIO> rawFile;
+        DdsInfo first;
+        NetpbmInfo firstImage;
+        bool images = !options.inputs.empty() && isNetpbmPath(options.inputs.front());
+        bool rgba = images || !options.rawRgba.empty();
+
+        if (images) {
+            firstImage = readNetpbmInfo(options.inputs.front());
+            options.settings.width = firstImage.width;
+            options.settings.height = firstImage.height;
+            frameCount = static_cast<uint32_t>(options.inputs.size());
+        }
+        else if (!options.inputs.empty()) {
+            first = readDdsInfo(options.inputs.front());
+            options.settings.width = first.width;
+            options.settings.height = first.height;
+            options.settings.format = first.format;
+            frameCount = static_cast<uint32_t>(options.inputs.size());
+        }
+
+        std::unique_ptr<GpuVideoBlockEncoder> blockEncoder;
+        if (rgba) {
+            blockEncoder.reset(new GpuVideoBlockEncoder(options.settings.format, options.quality));
+        }
+
+        GpuVideoWriter writer(options.output.c_str(), options.settings);
+        uint32_t frameBytes = writer.getFrameBytes();
+        size_t rgbaBytes = static_cast<size_t>(options.settings.width) * options.settings.height * 4;
+
+        // RGBA frames: read, then block compress on the writer's worker thread.
+        // Frames already run in parallel, so each one is encoded on a single thread.
+        auto compress = [&](uint8_t* dst, const std::function<void(uint8_t*)>& read) {
+            static thread_local std::vector<uint8_t> pixels;
+            pixels.resize(rgbaBytes);
+            read(pixels.data());
+            blockEncoder->encode(pixels.data(), options.settings.width, options.settings.height, options.settings.width * 4, dst, 1);
+        };
+
+        if (images) {
+            source = [&](uint8_t* dst, uint32_t frame) {
+                compress(dst, [&](uint8_t* pixels) { readNetpbmFrame(options.inputs[frame], firstImage, pixels); });
+            };
+        }
+        else if (!options.inputs.empty()) {
+            source = [&](uint8_t* dst, uint32_t frame) {
+                readDdsFrame(options.inputs[frame], first, dst, frameBytes);
+            };
+        }
+        else if (rgba) {
+            rawFile.reset(new GpuVideoIO(options.rawRgba.c_str(), "rb"));
+            rawFile->seek(0, SEEK_END);
+            int64_t rawBytes = rawFile->tellg();
+            if (rawBytes <= 0 || rawBytes % rgbaBytes != 0) {
+                throw std::runtime_error(options.rawRgba + ": size is not a multiple of " + std::to_string(rgbaBytes) + " byte frames");
+            }
+            frameCount = static_cast<uint32_t>(rawBytes / rgbaBytes);
+            source = [&](uint8_t* dst, uint32_t frame) {
+                compress(dst, [&](uint8_t* pixels) {
+                    if (rawFile->pread(pixels, rgbaBytes, static_cast<int64_t>(frame) * rgbaBytes) != rgbaBytes) {
+                        throw std::runtime_error(options.rawRgba + ": read failed");
+                    }
+                });
+            };
+        }
+        else {
+            rawFile.reset(new GpuVideoIO(options.raw.c_str(), "rb"));
+            rawFile->seek(0, SEEK_END);
+            int64_t rawBytes = rawFile->tellg();
+            if (rawBytes <= 0 || rawBytes % frameBytes != 0) {
+                throw std::runtime_error(options.raw + ": size is not a multiple of " + std::to_string(frameBytes) + " byte frames");
+            }
+            frameCount = static_cast<uint32_t>(rawBytes / frameBytes);
+            source = [&](uint8_t* dst, uint32_t frame) {
+                if (rawFile->pread(dst, frameBytes, static_cast<int64_t>(frame) * frameBytes) != frameBytes) {
+                    throw std::runtime_error(options.raw + ": read failed");
+                }
+            };
+        }
+
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        uint32_t reported = 0;
+        started = true;
+        writer.encode(frameCount, source, [&](uint32_t written) {
+            if (!options.quiet && (written == frameCount || written >= reported + std::max(1u, frameCount / 20))) {
+                reported = written;
+                std::fprintf(stderr, "\r%u / %u frames", written, frameCount);
+            }
+        });
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        if (!options.quiet) {
+            std::fprintf(stderr, "\n");
+        }
+
+        double inputMb = static_cast<double>(frameBytes) * frameCount / (1024.0 * 1024.0);
+        double outputMb = static_cast<double>(writer.getFileBytes()) / (1024.0 * 1024.0);
+        std::printf("%s: %ux%u, format %u, %u frames, %.1f MB -> %.1f MB (%.1f%%), level %d, %.2f s, %.1f MB/s\n",
+            options.output.c_str(), options.settings.width, options.settings.height, (uint32_t)options.settings.format, frameCount,
+            inputMb, outputMb, inputMb > 0.0 ? outputMb * 100.0 / inputMb : 0.0, options.settings.level,
+            seconds, seconds > 0.0 ? inputMb / seconds : 0.0);
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "error: %s\n", e.what());
+        if (started) {
+            // Do not leave a truncated file behind.
+            std::remove(options.output.c_str());
+        }
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,139 @@
+//
+//  NetpbmFile.h
+//
+//  Minimal reader for the uncompressed RGB / RGBA images the encoder accepts.
+//
+
+#pragma once
+
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "GpuVideoIO.h"
+
+struct NetpbmInfo {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // 3 (P6 ppm, P7 RGB pam) or 4 (P7 RGB_ALPHA pam)
+    uint32_t channels = 0;
+    uint32_t dataAt = 0;
+};
+
+inline bool isNetpbmPath(const std::string& path) {
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos) {
+        return false;
+    }
+    std::string ext = path.substr(dot + 1);
+    for (char& c : ext) {
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+    return ext == "ppm" || ext == "pam";
+}
+
+// Reads a binary P6 (maxval 255) or P7 (DEPTH 3 or 4, MAXVAL 255) header.
+inline NetpbmInfo readNetpbmInfo(GpuVideoIO& io, const std::string& path) {
+    char header[512] = {};
+    size_t size = io.pread(header, sizeof(header) - 1, 0);
+    std::string text(header, size);
+    if (text.size() < 3 || text[0] != 'P' || (text[1] != '6' && text[1] != '7')) {
+        throw std::runtime_error(path + ": not a binary ppm / pam file");
+    }
+
+    NetpbmInfo info;
+    size_t at = 2;
+    auto token = [&]() {
+        for (;;) {
+            while (at < text.size() && isspace(static_cast<unsigned char>(text[at]))) {
+                ++at;
+            }
+            if (at < text.size() && text[at] == '#') {
+                at = text.find('\n', at);
+                at = at == std::string::npos ? text.size() : at;
+                continue;
+            }
+            break;
+        }
+        size_t begin = at;
+        while (at < text.size() && !isspace(static_cast<unsigned char>(text[at]))) {
+            ++at;
+        }
+        return text.substr(begin, at - begin);
+    };
+
+    uint32_t maxval = 0;
+    if (text[1] == '6') {
+        info.width = static_cast<uint32_t>(std::atoi(token().c_str()));
+        info.height = static_cast<uint32_t>(std::atoi(token().c_str()));
+        maxval = static_cast<uint32_t>(std::atoi(token().c_str()));
+        info.channels = 3;
+        // exactly one whitespace byte before the pixels
+        ++at;
+    }
+    else {
+        for (std::string key = token(); key != "ENDHDR"; key = token()) {
+            if (key.empty()) {
+                throw std::runtime_error(path + ": truncated pam header");
+            }
+            if (key == "WIDTH") {
+                info.width = static_cast<uint32_t>(std::atoi(token().c_str()));
+            }
+            else if (key == "HEIGHT") {
+                info.height = static_cast<uint32_t>(std::atoi(token().c_str()));
+            }
+            else if (key == "DEPTH") {
+                info.channels = static_cast<uint32_t>(std::atoi(token().c_str()));
+            }
+            else if (key == "MAXVAL") {
+                maxval = static_cast<uint32_t>(std::atoi(token().c_str()));
+            }
+            else if (key == "TUPLTYPE") {
+                // RGB / RGB_ALPHA, implied by DEPTH
+                token();
+            }
+        }
+        at = text.find('\n', at);
+        at = at == std::string::npos ? text.size() : at + 1;
+    }
+    if (info.width == 0 || info.height == 0 || maxval != 255 || (info.channels != 3 && info.channels != 4)) {
+        throw std::runtime_error(path + ": only 8 bit RGB / RGBA images are supported");
+    }
+    info.dataAt = static_cast<uint32_t>(at);
+    return info;
+}
+
+inline NetpbmInfo readNetpbmInfo(const std::string& path) {
+    GpuVideoIO io(path.c_str(), "rb");
+    return readNetpbmInfo(io, path);
+}
+
+// Reads an image matching expected into dst as RGBA8 (alpha 255 for RGB files).
+inline void readNetpbmFrame(const std::string& path, const NetpbmInfo& expected, uint8_t* dst) {
+    GpuVideoIO io(path.c_str(), "rb");
+    NetpbmInfo info = readNetpbmInfo(io, path);
+    if (info.width != expected.width || info.height != expected.height) {
+        throw std::runtime_error(path + ": size differs from the first frame");
+    }
+    size_t pixels = static_cast<size_t>(info.width) * info.height;
+    size_t bytes = pixels * info.channels;
+    if (info.channels == 4) {
+        if (io.pread(dst, bytes, info.dataAt) != bytes) {
+            throw std::runtime_error(path + ": truncated");
+        }
+        return;
+    }
+    std::vector<uint8_t> rgb(bytes);
+    if (io.pread(rgb.data(), bytes, info.dataAt) != bytes) {
+        throw std::runtime_error(path + ": truncated");
+    }
+    for (size_t i = 0; i < pixels; ++i) {
+        dst[i * 4 + 0] = rgb[i * 3 + 0];
+        dst[i * 4 + 1] = rgb[i * 3 + 1];
+        dst[i * 4 + 2] = rgb[i * 3 + 2];
+        dst[i * 4 + 3] = 255;
+    }
+}